@@ -120,7 +120,23 @@ void copy_atm(ctl_t *ctl,
     memcpy(atm_dest->q[ig], atm_src->q[ig], s);
   for(iw=0; iw<ctl->nw; iw++)
     memcpy(atm_dest->k[iw], atm_src->k[iw], s);
-  atm_dest->init=atm_src->init;
+  atm_dest->hyd.np=0;
+  if(atm_src->hyd.np==atm_src->np) {
+    atm_dest->hyd.np=atm_src->hyd.np;
+    atm_dest->hyd.hydz=atm_src->hyd.hydz;
+    atm_dest->hyd.ig_h2o=atm_src->hyd.ig_h2o;
+    memcpy(atm_dest->hyd.z, atm_src->hyd.z, s);
+    memcpy(atm_dest->hyd.lat, atm_src->hyd.lat, s);
+    memcpy(atm_dest->hyd.p, atm_src->hyd.p, s);
+    memcpy(atm_dest->hyd.t, atm_src->hyd.t, s);
+    memcpy(atm_dest->hyd.h2o, atm_src->hyd.h2o, s);
+  }
+  
+  /* Set up interpolation context if source has one... */
+  if(atm_src->ipol.ip==ctl->ip)
+    intpol_atm_init(ctl, atm_dest);
+  else
+    atm_dest->ipol.ip=0;
   
   /* Initialize... */
   if(init)
@@ -165,22 +181,32 @@ void hydrostatic(ctl_t *ctl,
   
   double lat0=-999, lon0=-999;
   
-  int ip, ip0=-999;
+  int ig_h2o, ip, ip0=-999;
   
   /* Check reference height... */
   if(ctl->hydz<0)
     return;
   
+  /* Check state of last balancing... */
+  ig_h2o=find_emitter(ctl, "H2O");
+  if(atm->hyd.np!=atm->np || atm->hyd.hydz!=ctl->hydz
+     || atm->hyd.ig_h2o!=ig_h2o) {
+    atm->hyd.np=0;
+    atm->hyd.hydz=ctl->hydz;
+    atm->hyd.ig_h2o=ig_h2o;
+  }
+  
   /* Apply hydrostatic equation to individual profiles... */
   for(ip=0; ip<atm->np; ip++)
     if(atm->lon[ip]!=lon0 || atm->lat[ip]!=lat0) {
       if(ip>0)
-	hydrostatic_1d(ctl, atm, ip0, ip);
+	hydrostatic_check(ctl, atm, ip0, ip);
       lon0=atm->lon[ip];
       lat0=atm->lat[ip];
       ip0=ip;
     }
-  hydrostatic_1d(ctl, atm, ip0, atm->np);
+  hydrostatic_check(ctl, atm, ip0, atm->np);
+  atm->hyd.np=atm->np;
 }
 
 /*****************************************************************************/
@@ -192,7 +218,7 @@ void hydrostatic_1d(ctl_t *ctl,
   
   static int ig_h2o=-999;
   
-  double dzmin=1e99, e=0, mean, mmair=28.96456e-3, mmh2o=18.0153e-3, z;
+  double dzmin=1e99, e=0, g0, mean, mmair=28.96456e-3, mmh2o=18.0153e-3, z;
   
   int i, ip, ipref=0, ipts=20;
   
@@ -207,6 +233,10 @@ void hydrostatic_1d(ctl_t *ctl,
       ipref=ip;
     }
   
+  /* Get latitude-dependent part of gravity (see gravity)... */
+  g0=9.780318*(1+0.0053024*gsl_pow_2(sin(atm->lat[ipref]/180*M_PI))
+	       -0.0000058*gsl_pow_2(sin(2*atm->lat[ipref]/180*M_PI)));
+  
   /* Upper part of profile... */
   for(ip=ipref+1; ip<ip1; ip++) {
     mean=0;
@@ -216,7 +246,7 @@ void hydrostatic_1d(ctl_t *ctl,
 	e=LIN(0.0, atm->q[ig_h2o][ip-1],
 	      ipts-1.0, atm->q[ig_h2o][ip], (double)i);
       mean+=(e*mmh2o+(1-e)*mmair)
-	*gravity(z, atm->lat[ipref])/GSL_CONST_MKSA_MOLAR_GAS
+	*(g0-3.086e-3*z)/GSL_CONST_MKSA_MOLAR_GAS
 	/LIN(0.0, atm->t[ip-1], ipts-1.0, atm->t[ip], (double)i)/ipts;
     }
     
@@ -233,7 +263,7 @@ void hydrostatic_1d(ctl_t *ctl,
 	e=LIN(0.0, atm->q[ig_h2o][ip+1],
 	      ipts-1.0, atm->q[ig_h2o][ip], (double)i);
       mean+=(e*mmh2o+(1-e)*mmair)
-	*gravity(z, atm->lat[ipref])/GSL_CONST_MKSA_MOLAR_GAS
+	*(g0-3.086e-3*z)/GSL_CONST_MKSA_MOLAR_GAS
 	/LIN(0.0, atm->t[ip+1], ipts-1.0, atm->t[ip], (double)i)/ipts;
     }
     
@@ -244,19 +274,59 @@ void hydrostatic_1d(ctl_t *ctl,
 
 /*****************************************************************************/
 
+void hydrostatic_check(ctl_t *ctl,
+		       atm_t *atm,
+		       int ip0,
+		       int ip1) {
+  
+  hyd_t *hyd=&atm->hyd;
+  
+  size_t s;
+  
+  /* Data size... */
+  s=(size_t)(ip1-ip0)*sizeof(double);
+  
+  /* Skip profile if unchanged since last balancing... */
+  if(hyd->np==atm->np
+     && memcmp(&hyd->z[ip0], &atm->z[ip0], s)==0
+     && memcmp(&hyd->lat[ip0], &atm->lat[ip0], s)==0
+     && memcmp(&hyd->p[ip0], &atm->p[ip0], s)==0
+     && memcmp(&hyd->t[ip0], &atm->t[ip0], s)==0
+     && (hyd->ig_h2o<0
+	 || memcmp(&hyd->h2o[ip0], &atm->q[hyd->ig_h2o][ip0], s)==0))
+    return;
+  
+  /* Balance profile... */
+  hydrostatic_1d(ctl, atm, ip0, ip1);
+  
+  /* Save state... */
+  memcpy(&hyd->z[ip0], &atm->z[ip0], s);
+  memcpy(&hyd->lat[ip0], &atm->lat[ip0], s);
+  memcpy(&hyd->p[ip0], &atm->p[ip0], s);
+  memcpy(&hyd->t[ip0], &atm->t[ip0], s);
+  if(hyd->ig_h2o>=0)
+    memcpy(&hyd->h2o[ip0], &atm->q[hyd->ig_h2o][ip0], s);
+}
+
+/*****************************************************************************/
+
 void intpol_atm(ctl_t *ctl,
 		atm_t *atm_dest,
 		atm_t *atm_src) {
   
   double k[NWMAX], q[NGMAX];
   
-  int ig, ip, iw;
+  int hint=-1, ig, ip, iw;
+  
+  /* Set up interpolation context... */
+  if(atm_src->ipol.ip!=ctl->ip)
+    intpol_atm_init(ctl, atm_src);
   
   /* Interpolate atmospheric data... */
   for(ip=0; ip<atm_dest->np; ip++) {
     intpol_atm_geo(ctl, atm_src, atm_dest->z[ip], atm_dest->lon[ip],
-		   atm_dest->lat[ip], &atm_dest->p[ip], &atm_dest->t[ip],
-		   q, k);
+		   atm_dest->lat[ip], &hint, &atm_dest->p[ip],
+		   &atm_dest->t[ip], q, k);
     for(ig=0; ig<ctl->ng; ig++)
       atm_dest->q[ig][ip]=q[ig];
     for(iw=0; iw<ctl->nw; iw++)
@@ -271,6 +341,7 @@ void intpol_atm_geo(ctl_t *ctl,
 		    double z0,
 		    double lon0,
 		    double lat0,
+		    int *hint,
 		    double *p,
 		    double *t,
 		    double *q,
@@ -278,16 +349,20 @@ void intpol_atm_geo(ctl_t *ctl,
   
   /* 1D interpolation (vertical profile)... */
   if(ctl->ip==1)
-    intpol_atm_1d(ctl, atm, 0, atm->np, z0, p, t, q, k);
+    intpol_atm_1d(ctl, atm, 0, atm->np, z0, hint, p, t, q, k);
   
   /* 2D interpolation (satellite track)... */
   else if(ctl->ip==2)
-    intpol_atm_2d(ctl, atm, z0, lon0, lat0, p, t, q, k);
+    intpol_atm_2d(ctl, atm, z0, lon0, lat0, hint, p, t, q, k);
   
   /* 3D interpolation (Lagrangian grid)... */
   else if(ctl->ip==3)
     intpol_atm_3d(ctl, atm, z0, lon0, lat0, p, t, q, k);
   
+  /* 3D interpolation (regular grid)... */
+  else if(ctl->ip==4)
+    intpol_atm_grid(ctl, atm, z0, lon0, lat0, hint, p, t, q, k);
+  
   /* Wrong parameter... */
   else
     ERRMSG("Unknown interpolation method, check IP!");
@@ -300,6 +375,7 @@ void intpol_atm_1d(ctl_t *ctl,
 		   int idx0,
 		   int n,
 		   double z0,
+		   int *hint,
 		   double *p,
 		   double *t,
 		   double *q,
@@ -308,7 +384,12 @@ void intpol_atm_1d(ctl_t *ctl,
   int ig, ip, iw;
   
   /* Get array index... */
-  ip=idx0+locate(&atm->z[idx0], n, z0);
+  if(hint==NULL)
+    ip=idx0+locate(&atm->z[idx0], n, z0);
+  else {
+    *hint=locate_hint(&atm->z[idx0], n, z0, *hint);
+    ip=idx0+*hint;
+  }
   
   /* Interpolate... */
   *p=EXP(atm->z[ip], atm->p[ip], atm->z[ip+1], atm->p[ip+1], z0);
@@ -326,72 +407,69 @@ void intpol_atm_2d(ctl_t *ctl,
 		   double z0,
 		   double lon0,
 		   double lat0,
+		   int *hint,
 		   double *p,
 		   double *t,
 		   double *q,
 		   double *k) {
   
-  static double x1[NPMAX][3];
+  ipol_t *ipol=&atm->ipol;
   
-  static int idx[NPMAX], nx, nz[NPMAX];
+  double dh, dhmin0=1e99, dhmin1=1e99, k0[NWMAX], k1[NWMAX], p0, p1,
+    q0[NGMAX], q1[NGMAX], r, r0, r1, t0, t1, x0[3], x, x2;
   
-  double dh, dhmin0=1e99, dhmin1=1e99, k0[NWMAX], k1[NWMAX], lat1=-999,
-    lon1=-999, p0, p1, q0[NGMAX], q1[NGMAX], r, r0, r1, t0, t1, x0[3], x, x2;
+  int iax, ig, il, ir, ix, iw, ix0=0, ix1=0, nx;
   
-  int ig, ip, ix, iw, ix0=0, ix1=0;
-  
-  /* Initialize... */
-  if(!atm->init) {
-    atm->init=1;
-    
-    /* Determine grid dimensions... */
-    nx=0;
-    for(ip=0; ip<atm->np; ip++) {
-      if(atm->lon[ip]!=lon1 || atm->lat[ip]!=lat1) {
-	if((++nx)>NPMAX)
-	  ERRMSG("Too many profiles!");
-	nz[nx-1]=0;
-	lon1=atm->lon[ip];
-	lat1=atm->lat[ip];
-	geo2cart(0, lon1, lat1, x1[nx-1]);
-	idx[nx-1]=ip;
-      }
-      nz[nx-1]++;
-    }
-
-    /* Check profiles... */
-    for(ix=0; ix<nx; ix++)
-      if(nz[ix]<=1)
-	ERRMSG("Cannot identify profiles. Check ordering of data points!");
-  }
+  /* Check interpolation context... */
+  if(ipol->ip!=ctl->ip)
+    ERRMSG("Interpolation context of atmospheric data not set up!");
+  iax=ipol->iax;
+  nx=ipol->nx;
   
   /* Get Cartesian coordinates... */
   geo2cart(0, lon0, lat0, x0);
   
-  /* Find next neighbours... */
-  for(ix=0; ix<nx; ix++) {
-    
-    /* Get squared horizontal distance... */
-    dh=DIST2(x0, x1[ix]);
-    
-    /* Find neighbours... */
-    if(dh<=dhmin0) {
-      dhmin1=dhmin0;
-      ix1=ix0;
-      dhmin0=dh;
-      ix0=ix;
-    } else if(dh<=dhmin1) {
-      dhmin1=dh;
-      ix1=ix;
+  /* Find next neighbours (searching outward along the sorted axis)... */
+  if(nx>1) {
+    il=locate(ipol->xs, nx, x0[iax]);
+    ir=il+1;
+    while(il>=0 || ir<nx) {
+      
+      /* Take closest remaining profile along the axis... */
+      if(ir>=nx
+	 || (il>=0 && x0[iax]-ipol->xs[il]<=ipol->xs[ir]-x0[iax]))
+	ix=(int)ipol->ord[il--];
+      else
+	ix=(int)ipol->ord[ir++];
+      
+      /* Stop if axis distance alone exceeds second-nearest distance... */
+      if((x0[iax]-ipol->x[ix][iax])*(x0[iax]-ipol->x[ix][iax])>dhmin1)
+	break;
+      
+      /* Get squared horizontal distance... */
+      dh=DIST2(x0, ipol->x[ix]);
+      
+      /* Find neighbours (ties go to the later profile)... */
+      if(dh<dhmin0 || (dh==dhmin0 && ix>ix0)) {
+	dhmin1=dhmin0;
+	ix1=ix0;
+	dhmin0=dh;
+	ix0=ix;
+      } else if(dh<dhmin1 || (dh==dhmin1 && ix>ix1)) {
+	dhmin1=dh;
+	ix1=ix;
+      }
     }
   }
   
   /* Interpolate vertically... */
-  intpol_atm_1d(ctl, atm, idx[ix0], nz[ix0], z0, &p0, &t0, q0, k0);
-  intpol_atm_1d(ctl, atm, idx[ix1], nz[ix1], z0, &p1, &t1, q1, k1);
+  intpol_atm_1d(ctl, atm, ipol->idx[ix0], ipol->nz[ix0], z0, hint,
+		&p0, &t0, q0, k0);
+  intpol_atm_1d(ctl, atm, ipol->idx[ix1], ipol->nz[ix1], z0, hint,
+		&p1, &t1, q1, k1);
   
   /* Interpolate horizontally... */
-  x2=DIST2(x1[ix0], x1[ix1]);
+  x2=DIST2(ipol->x[ix0], ipol->x[ix1]);
   x=sqrt(x2);
   r0=(dhmin0-dhmin1+x2)/(2*x);
   r1=x-r0;
@@ -422,18 +500,52 @@ void intpol_atm_3d(ctl_t *ctl,
 		   double *q,
 		   double *k) {
   
-  static double x1[NPMAX][3];
+  ipol_t *ipol=&atm->ipol;
   
-  double dx2, dz, w, wsum, x0[3];
+  double dlon, dx2, dz, latmax, w, wsum, x0[3];
   
-  int ig, ip, iw;
+  int cand[NPMAX], ic, ig, ilat, ilat0, ilat1, ilon, ilon0, ilon1,
+    ip, iw, iz, iz0, iz1, n, nlon, nzc;
+  
+  /* Check interpolation context... */
+  if(ipol->ip!=ctl->ip)
+    ERRMSG("Interpolation context of atmospheric data not set up!");
+  nlon=ipol->nlon;
+  nzc=ipol->nzc;
   
   /* Get Cartesian coordinates... */
-  if(!atm->init) {
-    atm->init=1;
-    for(ip=0; ip<atm->np; ip++)
-      geo2cart(0, atm->lon[ip], atm->lat[ip], x1[ip]);
+  geo2cart(0, lon0, lat0, x0);
+  
+  /* Get range of grid cells within influence lengths... */
+  ilat0=GSL_MAX_INT((int)floor((lat0-ctl->cx/111.13+90)/ipol->dlat), 0);
+  ilat1=GSL_MIN_INT((int)floor((lat0+ctl->cx/111.13+90)/ipol->dlat),
+		    ipol->nlat-1);
+  latmax=GSL_MIN(fabs(lat0)+ctl->cx/111.13+ipol->dlat, 90);
+  if(cos(latmax*M_PI/180)>0.01
+     && (dlon=2*ctl->cx/(111.13*cos(latmax*M_PI/180))+ipol->dlat)<180) {
+    ilon0=(int)floor((lon0-dlon+180)/ipol->dlat);
+    ilon1=(int)floor((lon0+dlon+180)/ipol->dlat);
+    if(ilon1-ilon0+1>=nlon) {
+      ilon0=0;
+      ilon1=nlon-1;
+    }
+  } else {
+    ilon0=0;
+    ilon1=nlon-1;
   }
+  iz0=GSL_MAX_INT((int)floor((z0-ctl->cz-ipol->zmin)/ipol->dz), 0);
+  iz1=GSL_MIN_INT((int)floor((z0+ctl->cz-ipol->zmin)/ipol->dz), nzc-1);
+  
+  /* Collect candidate data points (in original order)... */
+  n=0;
+  for(ilat=ilat0; ilat<=ilat1; ilat++)
+    for(ilon=ilon0; ilon<=ilon1; ilon++)
+      for(iz=iz0; iz<=iz1; iz++) {
+	ic=(ilat*nlon+(ilon%nlon+nlon)%nlon)*nzc+iz;
+	for(ip=ipol->cstart[ic]; ip<ipol->cstart[ic+1]; ip++)
+	  cand[n++]=ipol->cidx[ip];
+      }
+  gsl_sort_int(cand, 1, (size_t)n);
   
   /* Initialize.. */
   *p=*t=wsum=0;
@@ -443,7 +555,8 @@ void intpol_atm_3d(ctl_t *ctl,
     k[iw]=0;
   
   /* Loop over grid points... */
-  for(ip=0; ip<atm->np; ip++) {
+  for(ic=0; ic<n; ic++) {
+    ip=cand[ic];
     
     /* Get vertical distance... */
     dz=fabs(atm->z[ip]-z0);
@@ -455,8 +568,7 @@ void intpol_atm_3d(ctl_t *ctl,
       continue;
     
     /* Get horizontal distance... */
-    geo2cart(0, lon0, lat0, x0);
-    dx2=DIST2(x0, x1[ip]);
+    dx2=DIST2(x0, ipol->x[ip]);
     if(dx2>gsl_pow_2(ctl->cx))
       continue;
     
@@ -484,6 +596,290 @@ void intpol_atm_3d(ctl_t *ctl,
 
 /*****************************************************************************/
 
+void intpol_atm_grid(ctl_t *ctl,
+		     atm_t *atm,
+		     double z0,
+		     double lon0,
+		     double lat0,
+		     int *hint,
+		     double *p,
+		     double *t,
+		     double *q,
+		     double *k) {
+  
+  ipol_t *ipol=&atm->ipol;
+  
+  double lon, w, wlat=0, wlon=0;
+  
+  int i, ig, ilat=0, ilat1=0, ilon=0, ilon1=0, ip0, ip1, iw, iz, jlat, jlon,
+    nlat, nlon, nz;
+  
+  /* Check interpolation context... */
+  if(ipol->ip!=ctl->ip)
+    ERRMSG("Interpolation context of atmospheric data not set up!");
+  nlat=ipol->nlat;
+  nlon=ipol->nlon;
+  nz=ipol->nzc;
+  
+  /* Get latitude index and weight... */
+  if(nlat>1) {
+    if(ipol->greg[0])
+      ilat=locate_reg(ipol->glat, nlat, lat0);
+    else
+      ilat=locate(ipol->glat, nlat, lat0);
+    ilat1=ilat+1;
+    wlat=(lat0-ipol->glat[ilat])/(ipol->glat[ilat1]-ipol->glat[ilat]);
+    wlat=GSL_MAX(GSL_MIN(wlat, 1), 0);
+  }
+  
+  /* Get longitude index and weight... */
+  if(nlon>1) {
+    lon=lon0;
+    if(ipol->gwrap)
+      lon=lon0-360*floor((lon0-ipol->glon[0])/360);
+    if(ipol->gwrap && lon>ipol->glon[nlon-1]) {
+      ilon=nlon-1;
+      ilon1=0;
+      wlon=(lon-ipol->glon[nlon-1])/(ipol->glon[0]+360-ipol->glon[nlon-1]);
+    } else {
+      if(ipol->greg[1])
+	ilon=locate_reg(ipol->glon, nlon, lon);
+      else
+	ilon=locate(ipol->glon, nlon, lon);
+      ilon1=ilon+1;
+      wlon=(lon-ipol->glon[ilon])/(ipol->glon[ilon1]-ipol->glon[ilon]);
+      wlon=GSL_MAX(GSL_MIN(wlon, 1), 0);
+    }
+  }
+  
+  /* Get altitude index... */
+  if(ipol->greg[2])
+    iz=locate_reg(ipol->gz, nz, z0);
+  else if(hint!=NULL)
+    iz=*hint=locate_hint(ipol->gz, nz, z0, *hint);
+  else
+    iz=locate(ipol->gz, nz, z0);
+  
+  /* Initialize... */
+  *p=*t=0;
+  for(ig=0; ig<ctl->ng; ig++)
+    q[ig]=0;
+  for(iw=0; iw<ctl->nw; iw++)
+    k[iw]=0;
+  
+  /* Interpolate vertically and bilinear in horizontal... */
+  for(i=0; i<4; i++) {
+    jlat=(i&1 ? ilat1 : ilat);
+    jlon=(i&2 ? ilon1 : ilon);
+    w=(i&1 ? wlat : 1-wlat)*(i&2 ? wlon : 1-wlon);
+    ip0=ipol->cidx[(jlat*nlon+jlon)*nz+iz];
+    ip1=ipol->cidx[(jlat*nlon+jlon)*nz+iz+1];
+    *p+=w*EXP(ipol->gz[iz], atm->p[ip0], ipol->gz[iz+1], atm->p[ip1], z0);
+    *t+=w*LIN(ipol->gz[iz], atm->t[ip0], ipol->gz[iz+1], atm->t[ip1], z0);
+    for(ig=0; ig<ctl->ng; ig++)
+      q[ig]+=w*LIN(ipol->gz[iz], atm->q[ig][ip0],
+		   ipol->gz[iz+1], atm->q[ig][ip1], z0);
+    for(iw=0; iw<ctl->nw; iw++)
+      k[iw]+=w*LIN(ipol->gz[iz], atm->k[iw][ip0],
+		   ipol->gz[iz+1], atm->k[iw][ip1], z0);
+  }
+}
+
+/*****************************************************************************/
+
+void intpol_atm_init(ctl_t *ctl,
+		     atm_t *atm) {
+  
+  ipol_t *ipol=&atm->ipol;
+  
+  double *axis[3], *data[3], dmax, lat1=-999, lon1=-999, xmax[3], xmin[3],
+    zmax;
+  
+  int cid[NPMAX], i, ic, ilat, ilon, ip, iz, ix, nax[3], nc;
+  
+  /* Reset context... */
+  ipol->ip=0;
+  
+  /* Allocate grid and index arrays according to number of data points... */
+  if((ctl->ip==3 || ctl->ip==4) && atm->np>ipol->npalloc) {
+    free(ipol->cidx);
+    free(ipol->glat);
+    free(ipol->glon);
+    free(ipol->gz);
+    ALLOC(ipol->cidx, int, atm->np);
+    ALLOC(ipol->glat, double, atm->np);
+    ALLOC(ipol->glon, double, atm->np);
+    ALLOC(ipol->gz, double, atm->np);
+    ipol->npalloc=atm->np;
+  }
+  
+  /* 2D interpolation (satellite track)... */
+  if(ctl->ip==2) {
+    
+    /* Determine grid dimensions... */
+    ipol->nx=0;
+    for(ip=0; ip<atm->np; ip++) {
+      if(atm->lon[ip]!=lon1 || atm->lat[ip]!=lat1) {
+	if((++ipol->nx)>NPMAX)
+	  ERRMSG("Too many profiles!");
+	ipol->nz[ipol->nx-1]=0;
+	lon1=atm->lon[ip];
+	lat1=atm->lat[ip];
+	geo2cart(0, lon1, lat1, ipol->x[ipol->nx-1]);
+	ipol->idx[ipol->nx-1]=ip;
+      }
+      ipol->nz[ipol->nx-1]++;
+    }
+    
+    /* Check profiles... */
+    for(ix=0; ix<ipol->nx; ix++)
+      if(ipol->nz[ix]<=1)
+	ERRMSG("Cannot identify profiles. Check ordering of data points!");
+    
+    /* Find Cartesian axis with largest spread of profiles... */
+    for(i=0; i<3; i++) {
+      xmin[i]=1e99;
+      xmax[i]=-1e99;
+      for(ix=0; ix<ipol->nx; ix++) {
+	xmin[i]=GSL_MIN(xmin[i], ipol->x[ix][i]);
+	xmax[i]=GSL_MAX(xmax[i], ipol->x[ix][i]);
+      }
+    }
+    ipol->iax=0;
+    for(i=1; i<3; i++)
+      if(xmax[i]-xmin[i]>xmax[ipol->iax]-xmin[ipol->iax])
+	ipol->iax=i;
+    
+    /* Sort profiles along this axis... */
+    for(ix=0; ix<ipol->nx; ix++)
+      ipol->xs[ix]=ipol->x[ix][ipol->iax];
+    gsl_sort_index(ipol->ord, ipol->xs, 1, (size_t)ipol->nx);
+    for(ix=0; ix<ipol->nx; ix++)
+      ipol->xs[ix]=ipol->x[ipol->ord[ix]][ipol->iax];
+  }
+  
+  /* 3D interpolation (Lagrangian grid)... */
+  else if(ctl->ip==3) {
+    
+    /* Get Cartesian coordinates... */
+    for(ip=0; ip<atm->np; ip++)
+      geo2cart(0, atm->lon[ip], atm->lat[ip], ipol->x[ip]);
+    
+    /* Set cell size of bucket grid (latitude, longitude, altitude)... */
+    ipol->zmin=gsl_stats_min(atm->z, 1, (size_t)atm->np);
+    zmax=gsl_stats_max(atm->z, 1, (size_t)atm->np);
+    ipol->dlat=GSL_MAX(ctl->cx/111.13, 1e-3);
+    ipol->dz=GSL_MAX(ctl->cz, 1e-3);
+    while(1) {
+      ipol->nlat=(int)(180/ipol->dlat)+1;
+      ipol->nlon=(int)(360/ipol->dlat)+1;
+      ipol->nzc=(int)((zmax-ipol->zmin)/ipol->dz)+1;
+      if((double)ipol->nlat*ipol->nlon*ipol->nzc<=4.*atm->np+64)
+	break;
+      ipol->dlat*=2;
+      ipol->dz*=2;
+    }
+    nc=ipol->nlat*ipol->nlon*ipol->nzc;
+    
+    /* Get grid cells of data points... */
+    for(ip=0; ip<atm->np; ip++) {
+      ilat=GSL_MIN_INT((int)((atm->lat[ip]+90)/ipol->dlat), ipol->nlat-1);
+      ilon=(int)((atm->lon[ip]+180-360*floor((atm->lon[ip]+180)/360))
+		 /ipol->dlat);
+      iz=(int)((atm->z[ip]-ipol->zmin)/ipol->dz);
+      cid[ip]=(GSL_MAX_INT(ilat, 0)*ipol->nlon
+	       +GSL_MIN_INT(ilon, ipol->nlon-1))*ipol->nzc
+	+GSL_MIN_INT(iz, ipol->nzc-1);
+    }
+    
+    /* Sort data points into grid cells (keeping their order)... */
+    for(ic=0; ic<=nc; ic++)
+      ipol->cstart[ic]=0;
+    for(ip=0; ip<atm->np; ip++)
+      ipol->cstart[cid[ip]+1]++;
+    for(ic=0; ic<nc; ic++)
+      ipol->cstart[ic+1]+=ipol->cstart[ic];
+    for(ip=0; ip<atm->np; ip++)
+      ipol->cidx[ipol->cstart[cid[ip]]++]=ip;
+    for(ic=nc; ic>0; ic--)
+      ipol->cstart[ic]=ipol->cstart[ic-1];
+    ipol->cstart[0]=0;
+  }
+  
+  /* 3D interpolation (regular grid)... */
+  else if(ctl->ip==4) {
+    
+    /* Get grid axes (latitude, longitude, altitude)... */
+    data[0]=atm->lat;
+    data[1]=atm->lon;
+    data[2]=atm->z;
+    axis[0]=ipol->glat;
+    axis[1]=ipol->glon;
+    axis[2]=ipol->gz;
+    for(i=0; i<3; i++) {
+      memcpy(axis[i], data[i], (size_t)atm->np*sizeof(double));
+      gsl_sort(axis[i], 1, (size_t)atm->np);
+      nax[i]=0;
+      for(ip=0; ip<atm->np; ip++)
+	if(nax[i]==0 || axis[i][ip]!=axis[i][nax[i]-1])
+	  axis[i][nax[i]++]=axis[i][ip];
+      
+      /* Check for regular spacing... */
+      ipol->greg[i]=(nax[i]>1);
+      for(ix=1; ix<nax[i]-1; ix++)
+	if(fabs(axis[i][ix+1]-axis[i][ix]-axis[i][1]+axis[i][0])
+	   >1e-6*(axis[i][1]-axis[i][0]))
+	  ipol->greg[i]=0;
+    }
+    ipol->nlat=nax[0];
+    ipol->nlon=nax[1];
+    ipol->nzc=nax[2];
+    
+    /* Check grid... */
+    if(ipol->nzc<2)
+      ERRMSG("Cannot identify profiles. Check ordering of data points!");
+    if(ipol->nlat*ipol->nlon*ipol->nzc!=atm->np)
+      ERRMSG("Atmospheric data do not form a regular grid!");
+    
+    /* Check that profiles are stored contiguously (see hydrostatic)... */
+    for(ip=0; ip<atm->np; ip++)
+      if(ip%ipol->nzc!=0
+	 && (atm->lon[ip]!=atm->lon[ip-1] || atm->lat[ip]!=atm->lat[ip-1]))
+	ERRMSG("Altitude must be the fastest-varying index of gridded data!");
+    
+    /* Check whether longitudes wrap around the globe... */
+    ipol->gwrap=0;
+    if(ipol->nlon>1) {
+      dmax=0;
+      for(ix=0; ix<ipol->nlon-1; ix++)
+	dmax=GSL_MAX(dmax, ipol->glon[ix+1]-ipol->glon[ix]);
+      ipol->gwrap=(ipol->glon[0]+360-ipol->glon[ipol->nlon-1]<=dmax*(1+1e-6));
+    }
+    
+    /* Get data point indices of grid nodes... */
+    for(ic=0; ic<atm->np; ic++)
+      ipol->cidx[ic]=-1;
+    for(ip=0; ip<atm->np; ip++) {
+      for(i=0; i<3; i++)
+	if(nax[i]>1) {
+	  cid[i]=locate(axis[i], nax[i], data[i][ip]);
+	  if(axis[i][cid[i]+1]==data[i][ip])
+	    cid[i]++;
+	} else
+	  cid[i]=0;
+      ic=(cid[0]*ipol->nlon+cid[1])*ipol->nzc+cid[2];
+      if(ipol->cidx[ic]>=0)
+	ERRMSG("Atmospheric data do not form a regular grid!");
+      ipol->cidx[ic]=ip;
+    }
+  }
+  
+  /* Set interpolation method... */
+  ipol->ip=ctl->ip;
+}
+
+/*****************************************************************************/
+
 void read_atm(const char *dirname,
 	      const char *filename,
 	      ctl_t *ctl,
@@ -491,12 +887,13 @@ void read_atm(const char *dirname,
   
   FILE *in;
   
-  char file[LEN], line[LEN], *tok;
+  char file[LEN], line[LEN], magic[4], *tok;
   
   int ig, iw;
   
   /* Init... */
-  atm->init=0;
+  atm->ipol.ip=0;
+  atm->hyd.np=0;
   atm->np=0;
   
   /* Set filename... */
@@ -512,24 +909,31 @@ void read_atm(const char *dirname,
   if(!(in=fopen(file, "r")))
     ERRMSG("Cannot open file!");
   
-  /* Read data... */
-  while(fgets(line, LEN, in)) {
-    
-    /* Read data... */
-    TOK(line, tok, "%lg", atm->time[atm->np]);
-    TOK(NULL, tok, "%lg", atm->z[atm->np]);
-    TOK(NULL, tok, "%lg", atm->lon[atm->np]);
-    TOK(NULL, tok, "%lg", atm->lat[atm->np]);
-    TOK(NULL, tok, "%lg", atm->p[atm->np]);
-    TOK(NULL, tok, "%lg", atm->t[atm->np]);
-    for(ig=0; ig<ctl->ng; ig++)
-      TOK(NULL, tok, "%lg", atm->q[ig][atm->np]);
-    for(iw=0; iw<ctl->nw; iw++)
-      TOK(NULL, tok, "%lg", atm->k[iw][atm->np]);
-    
-    /* Increment data point counter... */
-    if((++atm->np)>NPMAX)
-      ERRMSG("Too many data points!");
+  /* Read binary data... */
+  if(fread(magic, 1, 4, in)==4 && memcmp(magic, "JATM", 4)==0)
+    read_atm_bin(in, ctl, atm);
+  
+  /* Read ASCII data... */
+  else {
+    rewind(in);
+    while(fgets(line, LEN, in)) {
+      
+      /* Read data... */
+      TOKD(line, tok, atm->time[atm->np]);
+      TOKD(NULL, tok, atm->z[atm->np]);
+      TOKD(NULL, tok, atm->lon[atm->np]);
+      TOKD(NULL, tok, atm->lat[atm->np]);
+      TOKD(NULL, tok, atm->p[atm->np]);
+      TOKD(NULL, tok, atm->t[atm->np]);
+      for(ig=0; ig<ctl->ng; ig++)
+	TOKD(NULL, tok, atm->q[ig][atm->np]);
+      for(iw=0; iw<ctl->nw; iw++)
+	TOKD(NULL, tok, atm->k[iw][atm->np]);
+      
+      /* Increment data point counter... */
+      if((++atm->np)>NPMAX)
+	ERRMSG("Too many data points!");
+    }
   }
   
   /* Close file... */
@@ -542,6 +946,55 @@ void read_atm(const char *dirname,
 
 /*****************************************************************************/
 
+void read_atm_bin(FILE *in,
+		  ctl_t *ctl,
+		  atm_t *atm) {
+  
+  char name[64];
+  
+  int ig, iw, n;
+  
+  /* Check version... */
+  FREAD(&n, int, 1, in);
+  if(n!=1)
+    ERRMSG("Unknown version of binary data!");
+  
+  /* Check emitters... */
+  FREAD(&n, int, 1, in);
+  if(n!=ctl->ng)
+    ERRMSG("Number of emitters does not match control parameters!");
+  for(ig=0; ig<ctl->ng; ig++) {
+    FREAD(name, char, 64, in);
+    if(strncmp(name, ctl->emitter[ig], 64)!=0)
+      ERRMSG("Emitters do not match control parameters!");
+  }
+  
+  /* Check spectral windows... */
+  FREAD(&n, int, 1, in);
+  if(n!=ctl->nw)
+    ERRMSG("Number of spectral windows does not match control parameters!");
+  
+  /* Get number of data points... */
+  FREAD(&atm->np, int, 1, in);
+  FREAD(&n, int, 1, in);
+  if(atm->np>NPMAX)
+    ERRMSG("Too many data points!");
+  
+  /* Read data... */
+  FREAD(atm->time, double, atm->np, in);
+  FREAD(atm->z, double, atm->np, in);
+  FREAD(atm->lon, double, atm->np, in);
+  FREAD(atm->lat, double, atm->np, in);
+  FREAD(atm->p, double, atm->np, in);
+  FREAD(atm->t, double, atm->np, in);
+  for(ig=0; ig<ctl->ng; ig++)
+    FREAD(atm->q[ig], double, atm->np, in);
+  for(iw=0; iw<ctl->nw; iw++)
+    FREAD(atm->k[iw], double, atm->np, in);
+}
+
+/*****************************************************************************/
+
 void write_atm(const char *dirname,
 	       const char *filename,
 	       ctl_t *ctl,
@@ -566,6 +1019,13 @@ void write_atm(const char *dirname,
   if(!(out=fopen(file, "w")))
     ERRMSG("Cannot create file!");
   
+  /* Write binary data... */
+  if(ctl->atmfmt==2) {
+    write_atm_bin(out, ctl, atm);
+    fclose(out);
+    return;
+  }
+  
   /* Write header... */
   fprintf(out,
 	  "# $1 = time (seconds since 2000-01-01T00:00Z)\n"
@@ -598,3 +1058,41 @@ void write_atm(const char *dirname,
 }
 
 /*****************************************************************************/
+
+void write_atm_bin(FILE *out,
+		   ctl_t *ctl,
+		   atm_t *atm) {
+  
+  char name[64];
+  
+  int ig, iw, n;
+  
+  /* Write header... */
+  FWRITE("JATM", char, 4, out);
+  n=1;
+  FWRITE(&n, int, 1, out);
+  FWRITE(&ctl->ng, int, 1, out);
+  for(ig=0; ig<ctl->ng; ig++) {
+    if(strlen(ctl->emitter[ig])>=64)
+      ERRMSG("Emitter name too long for binary data!");
+    memset(name, 0, 64);
+    strcpy(name, ctl->emitter[ig]);
+    FWRITE(name, char, 64, out);
+  }
+  FWRITE(&ctl->nw, int, 1, out);
+  FWRITE(&atm->np, int, 1, out);
+  n=0;
+  FWRITE(&n, int, 1, out);
+  
+  /* Write data... */
+  FWRITE(atm->time, double, atm->np, out);
+  FWRITE(atm->z, double, atm->np, out);
+  FWRITE(atm->lon, double, atm->np, out);
+  FWRITE(atm->lat, double, atm->np, out);
+  FWRITE(atm->p, double, atm->np, out);
+  FWRITE(atm->t, double, atm->np, out);
+  for(ig=0; ig<ctl->ng; ig++)
+    FWRITE(atm->q[ig], double, atm->np, out);
+  for(iw=0; iw<ctl->nw; iw++)
+    FWRITE(atm->k[iw], double, atm->np, out);
+}
@@ -52,17 +52,26 @@ void hydrostatic_1d(ctl_t *ctl,
 		    atm_t *atm,
 		    int ip0,
 		    int ip1);
+
+/* Set hydrostatic equilibrium for profile if changed since last call. */
+void hydrostatic_check(ctl_t *ctl,
+		       atm_t *atm,
+		       int ip0,
+		       int ip1);
+
 /* Interpolate complete atmospheric data set. */
 void intpol_atm(ctl_t *ctl,
 		atm_t *atm_dest,
 		atm_t *atm_src);
 
-/* Interpolate atmospheric data for given geolocation. */
+/* Interpolate atmospheric data for given geolocation (hint: level index
+   kept between calls along a ray, or NULL). */
 void intpol_atm_geo(ctl_t *ctl,
 		    atm_t *atm,
 		    double z0,
 		    double lon0,
 		    double lat0,
+		    int *hint,
 		    double *p,
 		    double *t,
 		    double *q,
@@ -74,6 +83,7 @@ void intpol_atm_1d(ctl_t *ctl,
 		   int idx0,
 		   int n,
 		   double z0,
+		   int *hint,
 		   double *p,
 		   double *t,
 		   double *q,
@@ -85,6 +95,7 @@ void intpol_atm_2d(ctl_t *ctl,
 		   double z0,
 		   double lon0,
 		   double lat0,
+		   int *hint,
 		   double *p,
 		   double *t,
 		   double *q,
@@ -101,16 +112,42 @@ void intpol_atm_3d(ctl_t *ctl,
 		   double *q,
 		   double *k);
 
+/* Interpolate 3D atmospheric data (regular grid). */
+void intpol_atm_grid(ctl_t *ctl,
+		     atm_t *atm,
+		     double z0,
+		     double lon0,
+		     double lat0,
+		     int *hint,
+		     double *p,
+		     double *t,
+		     double *q,
+		     double *k);
+
+/* Set up interpolation context of atmospheric data. */
+void intpol_atm_init(ctl_t *ctl,
+		     atm_t *atm);
+
 /* Read atmospheric data. */
 void read_atm(const char *dirname,
 	      const char *filename,
 	      ctl_t *ctl,
 	      atm_t *atm);
 
+/* Read atmospheric data (binary format). */
+void read_atm_bin(FILE *in,
+		  ctl_t *ctl,
+		  atm_t *atm);
+
 /* Write atmospheric data. */
 void write_atm(const char *dirname,
 	       const char *filename,
 	       ctl_t *ctl,
 	       atm_t *atm);
 
+/* Write atmospheric data (binary format). */
+void write_atm_bin(FILE *out,
+		   ctl_t *ctl,
+		   atm_t *atm);
+
 #endif
@@ -201,9 +201,9 @@ void get_clim_data(int czone,
     TOK(NULL, tok, "%d", month2);
     TOK(NULL, tok, "%d", zang1);
     TOK(NULL, tok, "%d", zang2);
-    TOK(NULL, tok, "%lg", alt);
-    TOK(NULL, tok, "%lg", mean);
-    TOK(NULL, tok, "%lg", var);
+    TOKD(NULL, tok, alt);
+    TOKD(NULL, tok, mean);
+    TOKD(NULL, tok, var);
     
     /* Select climate zone */
     if ((lat==lat1 && month==month1 && zangle==zang1) || czone== 4){
@@ -451,8 +451,8 @@ double read_chisq(const char *dirname) {
   
   /* Read data... */
   while(fgets(line, LEN, in)) {
-    TOK(line, tok, "%lg", dummy);
-    TOK(NULL, tok, "%lg", chisq);
+    TOKD(line, tok, dummy);
+    TOKD(NULL, tok, chisq);
   }
   
   /* Close file... */
@@ -57,11 +57,24 @@ void read_ctl(int argc,
      !strcasecmp(ctl->sca_ext, "beta_e") && 
      !strcasecmp(ctl->sca_ext, "beta_a"))
     ERRMSG("Please set extinction to beta_a or beta_e.");
+  scan_ctl(argc, argv, "SCA_MIETAB", -1, "-", ctl->sca_mietab);
+  ctl->sca_qtol=scan_ctl(argc, argv, "SCA_QTOL", -1, "0", NULL);
+  ctl->sca_jac=(int)scan_ctl(argc, argv, "SCA_JAC", -1, "0", NULL);
+  ctl->sca_wtab=(int)scan_ctl(argc, argv, "SCA_WTAB", -1, "0", NULL);
+  ctl->sca_dz=scan_ctl(argc, argv, "SCA_DZ", -1, "0", NULL);
+  ctl->sca_ndir=(int)scan_ctl(argc, argv, "SCA_NDIR", -1, "0", NULL);
+  if(ctl->sca_ndir<0 || ctl->sca_ndir>NSCADIR)
+    ERRMSG("Set 0 <= SCA_NDIR <= NSCADIR!");
+  ctl->sca_fwd=scan_ctl(argc, argv, "SCA_FWD", -1, "0", NULL);
+  if(ctl->sca_fwd<0 || ctl->sca_fwd>=1)
+    ERRMSG("Set 0 <= SCA_FWD < 1!");
+  ctl->sca_queue=(int)scan_ctl(argc, argv, "SCA_QUEUE", -1, "0", NULL);
 
   /* Interpolation of atmospheric data... */
   ctl->ip=(int)scan_ctl(argc, argv, "IP", -1, "1", NULL);
   ctl->cz=scan_ctl(argc, argv, "CZ", -1, "0", NULL);
   ctl->cx=scan_ctl(argc, argv, "CX", -1, "0", NULL);
+  ctl->optdz=scan_ctl(argc, argv, "OPTDZ", -1, "0", NULL);
   
   /* Ray-tracing... */
   ctl->refrac=(int)scan_ctl(argc, argv, "REFRAC", -1, "1", NULL);
@@ -95,6 +108,8 @@ void read_ctl(int argc,
   /* Output flags... */
   ctl->write_bbt=(int)scan_ctl(argc, argv, "WRITE_BBT", -1, "0", NULL);
   ctl->write_matrix=(int)scan_ctl(argc, argv, "WRITE_MATRIX", -1, "0", NULL);
+  ctl->atmfmt=(int)scan_ctl(argc, argv, "ATMFMT", -1, "1", NULL);
+  ctl->obsfmt=(int)scan_ctl(argc, argv, "OBSFMT", -1, "1", NULL);
 }
 
 /*****************************************************************************/
@@ -106,60 +121,145 @@ double scan_ctl(int argc,
                 const char *defvalue,
                 char *value) {
   
+  static char **argv0=NULL, **key=NULL, **val=NULL;
+  
+  static int argc0=-1, *slot=NULL, *sfile=NULL, *sargv=NULL, n=0, nh=0;
+  
   FILE *in=NULL;
   
-  char dummy[LEN], fullname1[LEN], fullname2[LEN], line[LEN],
-    msg[2*LEN], rvarname[LEN], rval[LEN];
+  char dummy[LEN], fullname[2][LEN], line[LEN], msg[2*LEN], rvarname[LEN],
+    rval[LEN];
+  
+  const char *c;
   
-  int contain=0, i;
+  unsigned int h;
   
-  /* Open file... */
-  if(argv[1][0]!='-')
-    if(!(in=fopen(argv[1], "r")))
-      ERRMSG("Cannot open file!");
+  int i, ifile=-1, iargv=-1, j, m, nfile=0;
+  
+  /* Parse control file and command line only once... */
+  if(argv!=argv0 || argc!=argc0) {
+    argv0=argv;
+    argc0=argc;
+    
+    /* Free old entries... */
+    for(i=0; i<n; i++) {
+      free(key[i]);
+      free(val[i]);
+    }
+    if(key!=NULL) {
+      free(key);
+      free(val);
+      free(slot);
+      free(sfile);
+      free(sargv);
+    }
+    
+    /* Count entries... */
+    if(argv[1][0]!='-') {
+      if(!(in=fopen(argv[1], "r")))
+	ERRMSG("Cannot open file!");
+      while(fgets(line, LEN, in))
+	if(sscanf(line, "%s %s %s", rvarname, dummy, rval)==3)
+	  nfile++;
+    }
+    n=nfile+GSL_MAX_INT(argc-2, 0);
+    
+    /* Allocate... */
+    ALLOC(key, char*, n+1);
+    ALLOC(val, char*, n+1);
+    nh=16;
+    while(nh<2*(n+1))
+      nh*=2;
+    ALLOC(slot, int, nh);
+    ALLOC(sfile, int, nh);
+    ALLOC(sargv, int, nh);
+    for(h=0; h<(unsigned int)nh; h++)
+      slot[h]=sfile[h]=sargv[h]=-1;
+    
+    /* Get entries of control file (in order of appearance)... */
+    m=0;
+    if(in!=NULL) {
+      rewind(in);
+      while(fgets(line, LEN, in) && m<nfile)
+	if(sscanf(line, "%s %s %s", rvarname, dummy, rval)==3) {
+	  ALLOC(key[m], char, strlen(rvarname)+1);
+	  ALLOC(val[m], char, strlen(rval)+1);
+	  strcpy(key[m], rvarname);
+	  strcpy(val[m], rval);
+	  m++;
+	}
+      fclose(in);
+    }
+    
+    /* Get entries of command line... */
+    for(i=1; i<argc-1; i++) {
+      ALLOC(key[m], char, strlen(argv[i])+1);
+      ALLOC(val[m], char, strlen(argv[i+1])+1);
+      strcpy(key[m], argv[i]);
+      strcpy(val[m], argv[i+1]);
+      m++;
+    }
+    n=m;
+    
+    /* Build hash table (first entry of each name, case-insensitive)... */
+    for(i=0; i<n; i++) {
+      for(h=0, c=key[i]; *c!='\0'; c++)
+	h=31*h+(unsigned int)tolower((unsigned char)*c);
+      h&=(unsigned int)(nh-1);
+      while(slot[h]>=0 && strcasecmp(key[slot[h]], key[i])!=0)
+	h=(h+1)&(unsigned int)(nh-1);
+      if(slot[h]<0)
+	slot[h]=i;
+      if(i<nfile) {
+	if(sfile[h]<0)
+	  sfile[h]=i;
+      } else if(sargv[h]<0)
+	sargv[h]=i;
+    }
+  }
   
   /* Set full variable name... */
   if(arridx>=0) {
-    sprintf(fullname1, "%s[%d]", varname, arridx);
-    sprintf(fullname2, "%s[*]", varname);
+    sprintf(fullname[0], "%s[%d]", varname, arridx);
+    sprintf(fullname[1], "%s[*]", varname);
   } else{
-    sprintf(fullname1, "%s", varname);
-    sprintf(fullname2, "%s", varname);
+    sprintf(fullname[0], "%s", varname);
+    sprintf(fullname[1], "%s", varname);
   }
   
-  /* Read data... */
-  if(in!=NULL)
-    while(fgets(line, LEN, in))
-      if(sscanf(line, "%s %s %s", rvarname, dummy, rval)==3)
-        if(strcasecmp(rvarname, fullname1)==0 || 
-           strcasecmp(rvarname, fullname2)==0) {
-          contain=1;
-          break;
-        }
-  for(i=1; i<argc-1; i++)
-    if(strcasecmp(argv[i], fullname1)==0 || 
-       strcasecmp(argv[i], fullname2)==0) {
-      sprintf(rval, "%s", argv[i+1]);
-      contain=1;
-      break;
+  /* Find first entries in control file and command line... */
+  for(j=0; j<2; j++) {
+    for(h=0, c=fullname[j]; *c!='\0'; c++)
+      h=31*h+(unsigned int)tolower((unsigned char)*c);
+    h&=(unsigned int)(nh-1);
+    while(slot[h]>=0 && strcasecmp(key[slot[h]], fullname[j])!=0)
+      h=(h+1)&(unsigned int)(nh-1);
+    if(slot[h]>=0) {
+      if(sfile[h]>=0 && (ifile<0 || sfile[h]<ifile))
+	ifile=sfile[h];
+      if(sargv[h]>=0 && (iargv<0 || sargv[h]<iargv))
+	iargv=sargv[h];
     }
+  }
   
-  /* Close file... */
-  if(in!=NULL)
-    fclose(in);
+  /* Get value (command line overrides control file)... */
+  if(iargv>=0)
+    sprintf(rval, "%s", val[iargv]);
+  else if(ifile>=0)
+    sprintf(rval, "%s", val[ifile]);
   
   /* Check for missing variables... */
-  if(!contain) {
+  else {
     if(strlen(defvalue)>0)
       sprintf(rval, "%s", defvalue);
     else {
-      sprintf(msg, "Missing variable %s!\n", fullname1);
+      sprintf(msg, "Missing variable %s!\n", fullname[0]);
       ERRMSG(msg);
     }
   }
   
   /* Write info... */
-  printf("%s = %s\n", fullname1, rval);
+  printf("%s = %s\n", fullname[0], rval);
   
   /* Return values... */
   if(value!=NULL)
@@ -0,0 +1,25 @@
+#include "jurassic.h"
+#include "scatter.h"
+
+int main(int argc, char *argv[]) {
+  
+  static extdb_t db;
+  
+  /* Check arguments... */
+  if(argc<3)
+    ERRMSG("Give parameters: <extdb.tab> <extdb.bin>");
+  
+  /* Read optical properties database... */
+  read_extdb(argv[1], &db);
+  
+  /* Write binary database... */
+  write_extdb(argv[2], &db);
+  
+  /* Free... */
+  free(db.nu);
+  free(db.beta_e);
+  free(db.beta_s);
+  free(db.p);
+  
+  return EXIT_SUCCESS;
+}
@@ -17,7 +17,9 @@ void formod(ctl_t *ctl,
   
   static int mask[NDMAX][NRMAX];
   
-  int id, ir;
+  scaq_t *q=NULL;
+  
+  int id, il, ir;
   
   /* Save observation mask... */
   for(id=0; id<ctl->nd; id++)
@@ -27,13 +29,39 @@ void formod(ctl_t *ctl,
   /* Hydrostatic equilibrium... */
   hydrostatic(ctl, atm);
   
+  /* Set up interpolation context (before any parallel region)... */
+  if(atm->ipol.ip!=ctl->ip)
+    intpol_atm_init(ctl, atm);
+  
   /* Particles: Calculate optical properties in retrieval */
   if(ctl->retnn || ctl->retrr || ctl->retss) {
     get_opt_prop(ctl, aero);
   }
+  
+  /* Precompute point-local optics on altitude grid... */
+  formod_optics(ctl, atm, 0, 1, NULL, NULL);
+  
+  /* Check angular weights of scattering source... */
+  srcfunc_sca_1d_wgt(ctl, aero, NULL, 0, 0, 1, NULL);
+  
+  /* Precompute incident radiance field for scattering source... */
+  srcfunc_sca_field(ctl, atm, aero, 0, 0, 1, NULL);
 
+  /* Set up queue of secondary rays (plan/execute mode)... */
+  if(ctl->sca_queue && ctl->sca_n>0 && ctl->sca_mult>0) {
+    ALLOC(q, scaq_t, 1);
+    q->nb=0;
+    for(ir=0; ir<NRMAX; ir++) {
+      q->np[ir]=q->npmax[ir]=0;
+      q->x[ir]=q->dx[ir]=q->w[ir]=NULL;
+      q->il[ir]=q->ib[ir]=NULL;
+    }
+    for(il=0; il<NLMAX; il++)
+      q->ndir[il]=0;
+  }
+  
   /* Do first ray path sequential (to initialize model)... */
-  formod_pencil(ctl, atm, obs, aero, ctl->sca_mult, 0);
+  formod_pencil(ctl, atm, obs, aero, ctl->sca_mult, 0, q);
   
 #ifdef _OPENMP
 #pragma omp parallel for schedule(dynamic) private(ir,id)
@@ -41,7 +69,14 @@ void formod(ctl_t *ctl,
 
   /* Do remaining ray paths in parallel... */
   for(ir=1; ir<obs->nr; ir++){
-    formod_pencil(ctl, atm, obs, aero, ctl->sca_mult, ir);
+    formod_pencil(ctl, atm, obs, aero, ctl->sca_mult, ir, q);
+  }
+  
+  /* Trace queue of secondary rays and add scattering source... */
+  if(q) {
+    srcfunc_sca_queue(ctl, atm, aero, obs, q);
+    srcfunc_sca_collect(ctl, atm, aero, obs, q);
+    free_sca_queue(q);
   }
 
   /* Apply field-of-view convolution... */
@@ -166,12 +201,133 @@ void formod_fov(ctl_t *ctl,
 
 /*****************************************************************************/
 
+int formod_optics(ctl_t *ctl,
+		  atm_t *atm,
+		  double z,
+		  int init,
+		  double *beta_ctm,
+		  double *src_planck) {
+  
+  static double *beta, dz, *k, *p, *q, *src, *t, z0, *zs;
+  
+  static int np=0, nz=0;
+  
+  los_t *los;
+  
+  double w, zmax, zz;
+  
+  int chg, *dirty, hint=-1, id, ig, ip, iw, iz, reuse;
+  
+  /* Set up altitude grid... */
+  if(init) {
+    
+    /* Check if old grid can be reused... */
+    reuse=(nz>0 && ctl->ip==1 && ctl->optdz>0
+	   && np==atm->np && dz==ctl->optdz
+	   && memcmp(zs, atm->z, (size_t)np*sizeof(double))==0);
+    
+    /* Free old grid... */
+    if(nz>0 && !reuse) {
+      free(beta);
+      free(src);
+      free(zs);
+      free(p);
+      free(t);
+      free(q);
+      free(k);
+      nz=0;
+    }
+    
+    /* Check if grid is needed... */
+    if(ctl->ip!=1 || ctl->optdz<=0)
+      return 0;
+    
+    /* Get altitude range... */
+    z0=gsl_stats_min(atm->z, 1, (size_t)atm->np);
+    zmax=gsl_stats_max(atm->z, 1, (size_t)atm->np);
+    
+    /* Allocate... */
+    if(!reuse) {
+      dz=ctl->optdz;
+      nz=GSL_MAX_INT((int)ceil((zmax-z0)/dz)+1, 2);
+      np=atm->np;
+      ALLOC(beta, double, nz*ctl->nd);
+      ALLOC(src, double, nz*ctl->nd);
+      ALLOC(zs, double, np);
+      ALLOC(p, double, np);
+      ALLOC(t, double, np);
+      ALLOC(q, double, np*NGMAX);
+      ALLOC(k, double, np*NWMAX);
+      memcpy(zs, atm->z, (size_t)np*sizeof(double));
+    }
+    ALLOC(dirty, int, np);
+    ALLOC(los, los_t, 1);
+    
+    /* Find levels that changed since the last call... */
+    for(ip=0; ip<np; ip++) {
+      chg=(!reuse || p[ip]!=atm->p[ip] || t[ip]!=atm->t[ip]);
+      for(ig=0; ig<ctl->ng; ig++)
+	chg=(chg || q[ig*np+ip]!=atm->q[ig][ip]);
+      for(iw=0; iw<ctl->nw; iw++)
+	chg=(chg || k[iw*np+ip]!=atm->k[iw][ip]);
+      dirty[ip]=chg;
+      p[ip]=atm->p[ip];
+      t[ip]=atm->t[ip];
+      for(ig=0; ig<ctl->ng; ig++)
+	q[ig*np+ip]=atm->q[ig][ip];
+      for(iw=0; iw<ctl->nw; iw++)
+	k[iw*np+ip]=atm->k[iw][ip];
+    }
+    
+    /* Compute optics per unit path length... */
+    los->np=1;
+    los->ds[0]=1;
+    for(iz=0, ip=-1; iz<nz; iz++) {
+      
+      /* Skip grid points that only depend on unchanged levels... */
+      zz=GSL_MIN(z0+iz*dz, zmax);
+      ip=locate_hint(atm->z, np, zz, ip);
+      if(!dirty[ip] && !dirty[ip+1])
+	continue;
+      
+      intpol_atm_geo(ctl, atm, zz, 0, 0, &hint,
+		     &los->p[0], &los->t[0], los->q[0], los->k[0]);
+      for(ig=0; ig<ctl->ng; ig++)
+	los->u[0][ig]=10*los->q[0][ig]*los->p[0]
+	  /(GSL_CONST_MKSA_BOLTZMANN*los->t[0]);
+      formod_continua(ctl, los, 0, &beta[iz*ctl->nd]);
+      srcfunc_planck(ctl, los->t[0], &src[iz*ctl->nd]);
+    }
+    
+    /* Free... */
+    free(dirty);
+    free(los);
+    return 1;
+  }
+  
+  /* Check if grid is available... */
+  if(nz<=0)
+    return 0;
+  
+  /* Interpolate... */
+  iz=GSL_MIN_INT(GSL_MAX_INT((int)((z-z0)/dz), 0), nz-2);
+  w=GSL_MIN(GSL_MAX((z-z0)/dz-iz, 0), 1);
+  for(id=0; id<ctl->nd; id++) {
+    beta_ctm[id]=(1-w)*beta[iz*ctl->nd+id]+w*beta[(iz+1)*ctl->nd+id];
+    src_planck[id]=(1-w)*src[iz*ctl->nd+id]+w*src[(iz+1)*ctl->nd+id];
+  }
+  return 1;
+}
+
+/*****************************************************************************/
+
 void formod_pencil(ctl_t *ctl,
 		   atm_t *atm,
 		   obs_t *obs,
 		   aero_t *aero,
 		   int scattering,
-		   int ir) {
+		   int ir,
+		   scaq_t *q) {
   
   static int init=0;
 
@@ -179,10 +335,11 @@ void formod_pencil(ctl_t *ctl,
   
   los_t *los;  
   
-  double beta_ctm[NDMAX], beta_ext_tot, dx[3], eps, src_all, src_planck[NDMAX],
-    src_sca[NDMAX], tau_path[NGMAX][NDMAX], tau_gas[NDMAX], x[3], x0[3], x1[3];
+  double beta_ctm[NDMAX], beta_ext_tot, dx[3], eps, *loc=NULL, src_all,
+    src_planck[NDMAX], src_sca[NDMAX], tau_path[NGMAX][NDMAX], tau_gas[NDMAX],
+    x[3], x0[3], x1[3];
   
-  int i, id, ip, ip0, ip1;
+  int i, id, ip, ip0, ip1, isp=0, ok;
   
   /* Read tables... */
   if(!init) {
@@ -205,17 +362,44 @@ void formod_pencil(ctl_t *ctl,
   /* Raytracing... */
   raytrace(ctl, atm, obs, aero, los, ir);
   
+  /* Keep point-local quantities for mirrored LOS points... */
+  for(ip=0; ip<los->np; ip++)
+    if(los->mirror[ip]>=0) {
+      ALLOC(loc, double, 2*ctl->nd*los->np);
+      break;
+    }
+  
   /* Loop over LOS points... */
   for(ip=0; ip<los->np; ip++) {
     
     /* Get trace gas transmittance... */
     intpol_tbl(ctl, tbl, los, ip, tau_path, tau_gas);
     
-    /* Get continuum absorption... */
-    formod_continua(ctl, los, ip, beta_ctm);
+    /* Get continuum absorption and Planck function from altitude grid... */
+    ok=formod_optics(ctl, atm, los->z[ip], 0, beta_ctm, src_planck);
     
-    /* Compute Planck function... */
-    srcfunc_planck(ctl, los->t[ip], src_planck);
+    /* Reuse continuum absorption and Planck function of mirrored point... */
+    if(!ok && los->mirror[ip]>=0)
+      for(id=0; id<ctl->nd; id++) {
+	beta_ctm[id]=loc[2*ctl->nd*los->mirror[ip]+id];
+	src_planck[id]=loc[2*ctl->nd*los->mirror[ip]+ctl->nd+id];
+      }
+    
+    else if(!ok) {
+      
+      /* Get continuum absorption... */
+      formod_continua(ctl, los, ip, beta_ctm);
+      
+      /* Compute Planck function... */
+      srcfunc_planck(ctl, los->t[ip], src_planck);
+      
+      /* Save for mirrored points... */
+      if(loc)
+	for(id=0; id<ctl->nd; id++) {
+	  loc[2*ctl->nd*ip+id]=beta_ctm[id];
+	  loc[2*ctl->nd*ip+ctl->nd+id]=src_planck[id];
+	}
+    }
   
     /* Compute radiative transfer with scattering source... */
     if(los->aerofac[ip]>0 && scattering>0) {
@@ -229,7 +413,16 @@ void formod_pencil(ctl_t *ctl,
       for(i=0; i<3; i++)
 	dx[i]=x1[i]-x0[i];
 
-      srcfunc_sca(ctl,atm,aero,obs->time[ir],x,dx,los->aeroi[ip],src_sca,scattering);
+      /* Save scattering point (plan/execute mode, source is added
+	 after tracing the queue of secondary rays)... */
+      if(q!=NULL) {
+	isp=srcfunc_sca_plan(ctl, q, x, dx, los->aeroi[ip], ir);
+	for(id=0; id<ctl->nd; id++)
+	  src_sca[id]=0;
+      }
+      
+      else
+	srcfunc_sca(ctl,atm,aero,obs->time[ir],x,dx,los->aeroi[ip],src_sca,scattering);
 
       /* Loop over channels... */
       for(id=0; id<ctl->nd; id++)
@@ -251,6 +444,11 @@ void formod_pencil(ctl_t *ctl,
 	  	   los->aerofac[ip]*aero->beta_s[los->aeroi[ip]][id]*src_sca[id]) / 
                   beta_ext_tot;
 
+	  /* Save weight of scattering source (plan/execute mode)... */
+	  if(q!=NULL)
+	    q->w[ir][isp*ctl->nd+id]=obs->tau[id][ir]*eps*los->aerofac[ip]
+	      *aero->beta_s[los->aeroi[ip]][id]/beta_ext_tot;
+
 	  /* Compute radiance: path extinction * segment emissivity * segment source */
 	  obs->rad[id][ir] += obs->tau[id][ir]*eps*src_all;
 
@@ -297,6 +495,8 @@ void formod_pencil(ctl_t *ctl,
 
   /* Free... */
   free(los);
+  if(loc)
+    free(loc);
 }
 
 /*****************************************************************************/
@@ -478,6 +678,8 @@ void read_shape(const char *filename,
   
   char line[LEN];
   
+  double val[2];
+  
   /* Write info... */
   /*printf("Read shape function: %s\n", filename); */
   
@@ -488,9 +690,12 @@ void read_shape(const char *filename,
   /* Read data... */
   *n=0;
   while(fgets(line, LEN, in))
-    if(sscanf(line,"%lg %lg", &x[*n], &y[*n])==2)
+    if(scan_doubles(line, val, 2)==2) {
+      x[*n]=val[0];
+      y[*n]=val[1];
       if((++(*n))>NSHAPE)
         ERRMSG("Too many data points!");
+    }
   
   /* Check number of points... */
   if(*n<1)
@@ -509,7 +714,7 @@ void read_tbl(ctl_t *ctl,
   
   char filename[2*LEN], line[LEN];
   
-  double eps, eps_old, press, press_old, temp, temp_old, u, u_old;
+  double eps, eps_old, press, press_old, temp, temp_old, u, u_old, val[4];
   
   int id, ig, ip, it;
   
@@ -574,8 +779,12 @@ void read_tbl(ctl_t *ctl,
 	while(fgets(line, LEN, in)) {
 	  
 	  /* Parse line... */
-	  if(sscanf(line,"%lg %lg %lg %lg", &press, &temp, &u, &eps)!=4)
+	  if(scan_doubles(line, val, 4)!=4)
 	    continue;
+	  press=val[0];
+	  temp=val[1];
+	  u=val[2];
+	  eps=val[3];
 	  
 	  /* Determine pressure index... */
 	  if(press!=press_old) {
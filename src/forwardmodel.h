@@ -28,13 +28,22 @@ void formod_continua(ctl_t *ctl,
 void formod_fov(ctl_t *ctl,
 		obs_t *obs);
 
+/* Get continuum absorption and Planck function from altitude grid. */
+int formod_optics(ctl_t *ctl,
+		  atm_t *atm,
+		  double z,
+		  int init,
+		  double *beta_ctm,
+		  double *src_planck);
+
 /* Compute radiative transfer for a pencil beam. */
 void formod_pencil(ctl_t *ctl,
 		   atm_t *atm,
  		   obs_t *obs,
  		   aero_t *aero,
  		   int scattering,
- 		   int ir);
+ 		   int ir,
+		   scaq_t *q);
 
 /* Get transmittance from look-up tables. */
 void intpol_tbl(ctl_t *ctl,
@@ -12,6 +12,7 @@
 #include <gsl/gsl_spline.h>
 #include <gsl/gsl_statistics.h>
 #include <gsl/gsl_complex_math.h>
+#include <ctype.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -95,6 +96,13 @@
     } else ERRMSG("Error while reading!");		\
   }
 
+/* Read double value from string (same result as TOK with "%lg"). */
+#define TOKD(line, tok, var) {				\
+    if(((tok)=strtok((line), " \t"))) {			\
+      if(scan_doubles(tok, &(var), 1)!=1) continue;	\
+    } else ERRMSG("Error while reading!");		\
+  }
+
 /* ------------------------------------------------------------
    Redefinable constants...
    ------------------------------------------------------------ */
@@ -187,12 +195,33 @@
 /* Number of scattering angles (from 0 to 180 deg). */
 #define NTHETA 181
 
+/* Number of incident zenith angles for scattering source (1D). */
+#define NSCAALF 28
+
+/* Number of LOS zenith angles for scattering source weights (1D). */
+#define NSCAZEN 361
+
+/* Maximum number of directions for scattering source (3D). */
+#define NSCADIR 32400
+
+/* Maximum number of secondary rays in queue (plan/execute mode). */
+#define NSCAQ 1000000
+
 /* Number of points for Gauss-Hermite integration. */
 #define NRAD 170
 
+/* Maximum number of step halvings for adaptive log-normal integration. */
+#define NQLEV 8
+
 /* Maximum number of refractive indices. */
 #define REFMAX 5000
 
+/* Number of size parameters in Mie lookup tables. */
+#define MIENX 2000
+
+/* Maximum number of Mie lookup tables kept in memory. */
+#define MIETABMAX 16
+
 /* ------------------------------------------------------------
    Quantity indices...
    ------------------------------------------------------------ */
@@ -271,6 +300,37 @@ typedef struct {
   /* Extinction coefficient type if sca_mult=0 */
   char sca_ext[LEN];
 
+  /* Basename of Mie lookup tables (- to compute Mie theory directly). */
+  char sca_mietab[LEN];
+
+  /* Tolerance of adaptive integration over log-normal modes */
+  /* (0=Gauss-Hermite quadrature). */
+  double sca_qtol;
+
+  /* Use analytic derivatives of optical properties for particle */
+  /* kernels (0=no, 1=yes). */
+  int sca_jac;
+
+  /* Use tabulated angular weights for 1D scattering source */
+  /* (0=no, 1=yes). */
+  int sca_wtab;
+
+  /* Altitude step of precomputed incident radiance field for IP=1 */
+  /* (0=trace pencil beams at each scattering point) [km]. */
+  double sca_dz;
+
+  /* Number of directions for 3D scattering source */
+  /* (0=regular 180x180 grid, >0=spherical Fibonacci lattice). */
+  int sca_ndir;
+
+  /* Fraction of directions distributed according to phase function */
+  /* for 3D scattering source (0=uniform). */
+  double sca_fwd;
+
+  /* Trace secondary rays of primary scattering points from a global */
+  /* queue (0=recursive, 1=plan/execute). */
+  int sca_queue;
+
   /* Interpolation method (1=profile, 2=satellite track, 3=Lagrangian grid). */
   int ip;
 
@@ -280,6 +340,9 @@ typedef struct {
   /* Influence length for horizontal interpolation [km]. */
   double cx;
   
+  /* Altitude step of precomputed point-local optics for IP=1 [km]. */
+  double optdz;
+  
   /* Take into account refractivity (0=no, 1=yes). */
   int refrac;
   
@@ -339,6 +402,12 @@ typedef struct {
   
   /* Write matrix data (0=no, 1=yes). */
   int write_matrix;
+
+  /* Format of atmospheric data files (1=ASCII, 2=binary). */
+  int atmfmt;
+
+  /* Format of observation data files (1=ASCII, 2=binary). */
+  int obsfmt;
   
 } ctl_t;
 /* ------------------------------------------------------------*/
@@ -375,6 +444,9 @@ typedef struct {
 
   /* Aerosol/cloud layer scaling factor for transition layer */
   double aerofac[NLOS];
+
+  /* Index of mirrored LOS point with same local state (-1 if none). */
+  int mirror[NLOS];
  
   /* Surface temperature [K]. */
   double tsurf;
@@ -498,6 +570,9 @@ typedef struct {
   /* Width of log-normal size distribution */
   double ss[SCAMOD];
   
+  /* Linearize optical properties of perturbed modes (0=no, 1=yes) */
+  int lin;
+  
   /* Aerosol and cloud optical properties for radiative transfer */
 
   /* Number of aerosol/cloud layers */
@@ -529,6 +604,220 @@ typedef struct {
 
  } aero_t;
 
+/* Mie lookup table. */
+typedef struct {
+  
+  /* Refractive index file. */
+  char refrac[LEN];
+  
+  /* Wavenumber [cm^-1]. */
+  double nu;
+  
+  /* Real part of refractive index. */
+  double n_real;
+  
+  /* Imaginary part of refractive index. */
+  double n_imag;
+  
+  /* Logarithm of smallest size parameter. */
+  double lx0;
+  
+  /* Step size of logarithm of size parameter. */
+  double dlx;
+  
+  /* Extinction efficiency. */
+  double qext[MIENX];
+  
+  /* Scattering efficiency. */
+  double qsca[MIENX];
+  
+  /* Phase function. */
+  double phase[MIENX][NTHETA];
+  
+} mietab_t;
+
+/* Optical properties database for non-spherical particles. */
+typedef struct {
+  
+  /* Database file. */
+  char file[LEN];
+  
+  /* Number of wavenumbers. */
+  int n;
+  
+  /* Wavenumber [cm^-1]. */
+  double *nu;
+  
+  /* Extinction coefficient [1/km]. */
+  double *beta_e;
+  
+  /* Scattering coefficient [1/km]. */
+  double *beta_s;
+  
+  /* Phase function (n x NTHETA). */
+  double *p;
+  
+} extdb_t;
+
+/* Queue of secondary rays for scattering source (plan/execute mode). */
+typedef struct {
+  
+  /* Number of scattering points per primary ray. */
+  int np[NRMAX];
+  
+  /* Allocated number of scattering points per primary ray. */
+  int npmax[NRMAX];
+  
+  /* Position of scattering points (np x 3). */
+  double *x[NRMAX];
+  
+  /* LOS direction at scattering points (np x 3). */
+  double *dx[NRMAX];
+  
+  /* Aerosol/cloud layer index of scattering points. */
+  int *il[NRMAX];
+  
+  /* First secondary ray of scattering points (-1=radiance field). */
+  int *ib[NRMAX];
+  
+  /* Weight of scattering source in radiance of primary ray (np x nd). */
+  double *w[NRMAX];
+  
+  /* Number of directions of incident radiation per layer (3D). */
+  int ndir[NLMAX];
+  
+  /* Scattering angles of directions per layer (3D) [rad]. */
+  double *theta2[NLMAX];
+  
+  /* Azimuth angles of directions per layer (3D) [rad]. */
+  double *phi[NLMAX];
+  
+  /* Solid angles of directions per layer (3D) [sr]. */
+  double *domega[NLMAX];
+  
+  /* Number of secondary rays. */
+  int nb;
+  
+  /* Origin of secondary rays (nb x 3). */
+  double *xo;
+  
+  /* View point of secondary rays (nb x 3). */
+  double *xv;
+  
+  /* Primary ray of secondary rays. */
+  int *ir;
+  
+  /* Scattering point of secondary rays. */
+  int *ip;
+  
+  /* Scattering order of secondary rays. */
+  int *ord;
+  
+  /* Radiance of secondary rays (nb x nd) [W/(m^2 sr cm^-1)]. */
+  double *rad;
+  
+} scaq_t;
+
+/* Interpolation context of atmospheric data. */
+typedef struct {
+
+   /* Interpolation method the context was set up for (0=none). */
+   int ip;
+
+   /* Number of profiles (IP=2). */
+   int nx;
+
+   /* Index of first data point of each profile (IP=2). */
+   int idx[NPMAX];
+
+   /* Number of data points of each profile (IP=2). */
+   int nz[NPMAX];
+
+   /* Cartesian coordinates of profiles (IP=2) or data points (IP=3) [km]. */
+   double x[NPMAX][3];
+
+   /* Cartesian axis used for sorting profiles (IP=2). */
+   int iax;
+
+   /* Profile indices sorted along axis (IP=2). */
+   size_t ord[NPMAX];
+
+   /* Sorted axis coordinates of profiles (IP=2) [km]. */
+   double xs[NPMAX];
+
+   /* Cell size of bucket grid in latitude/longitude (IP=3) [deg]. */
+   double dlat;
+
+   /* Cell size of bucket grid in altitude (IP=3) [km]. */
+   double dz;
+
+   /* Lower altitude of bucket grid (IP=3) [km]. */
+   double zmin;
+
+   /* Number of grid cells in latitude (IP=3, IP=4). */
+   int nlat;
+
+   /* Number of grid cells in longitude (IP=3, IP=4). */
+   int nlon;
+
+   /* Number of grid cells in altitude (IP=3, IP=4). */
+   int nzc;
+
+   /* Start of grid cells in list of data points (IP=3). */
+   int cstart[4*NPMAX+65];
+
+   /* Number of data points the grid arrays are allocated for. */
+   int npalloc;
+
+   /* Data point indices sorted by grid cell (IP=3, IP=4). */
+   int *cidx;
+
+   /* Latitudes of atmospheric grid (IP=4) [deg]. */
+   double *glat;
+
+   /* Longitudes of atmospheric grid (IP=4) [deg]. */
+   double *glon;
+
+   /* Altitudes of atmospheric grid (IP=4) [km]. */
+   double *gz;
+
+   /* Regular spacing of latitudes, longitudes, and altitudes (IP=4). */
+   int greg[3];
+
+   /* Longitudes wrap around the globe (IP=4, 0=no, 1=yes). */
+   int gwrap;
+
+ } ipol_t;
+
+/* State of atmospheric data after last hydrostatic balancing. */
+typedef struct {
+
+   /* Number of data points (0=none). */
+   int np;
+
+   /* Reference height [km]. */
+   double hydz;
+
+   /* Emitter index of water vapor. */
+   int ig_h2o;
+
+   /* Altitude [km]. */
+   double z[NPMAX];
+
+   /* Latitude [deg]. */
+   double lat[NPMAX];
+
+   /* Pressure [hPa]. */
+   double p[NPMAX];
+
+   /* Temperature [K]. */
+   double t[NPMAX];
+
+   /* Water vapor volume mixing ratio. */
+   double h2o[NPMAX];
+
+ } hyd_t;
+
 /* Atmospheric data. */
 typedef struct { 
 
@@ -559,8 +848,11 @@ typedef struct {
    /* Extinction [1/km]. */
    double k[NWMAX][NPMAX];
 
-   /* Init flag for interpolation (0=no, 1=yes). */
-   int init;
+   /* Interpolation context. */
+   ipol_t ipol;
+
+   /* State after last hydrostatic balancing. */
+   hyd_t hyd;
 
  } atm_t;
 /* ------------------------------------------------------------*/
@@ -109,7 +109,7 @@ void read_altitudes(const char *dirname,
   /* Read data... */
   while(fgets(line, LEN, in)) {
     /* Read data... */
-    TOK(line, tok, "%lg", altis[*ii]);
+    TOKD(line, tok, altis[*ii]);
     /* Increment counter... */
     ++*ii;
   }
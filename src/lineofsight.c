@@ -9,11 +9,12 @@ void raytrace(ctl_t *ctl,
 	      los_t *los,
 	      int ir) {
   
-  double cosa, d, dmax, dmin=0, ds, ex0[3], ex1[3], h=0.02, k[NWMAX],
-    lat, lon, n, naux, ng[3], norm, p, q[NGMAX], 
-    t, x[3], xh[3], xobs[3], xvp[3], z=1e99, zmax, zmin, zrefrac=60;
+  double *alti=NULL, cosa, d, *dl=NULL, dmax, dmin=0, ds, ex0[3], ex1[3],
+    h=0.02, k[NWMAX], lat, lon, n, naux, ng[3], norm, p, q[NGMAX], 
+    t, x[3], xh[3], xl[3], xobs[3], xp[3], xvp[3], z=1e99, zalt, zmax,
+    zmin, znew, zp=0, zrefrac=60;
   /*zrefrac=25 for CRISTA-NF*/
-  int i, ig, ip, iw, stop=0;
+  int hint=-1, i, ig, il, ip, *ireg, iw, nalti=0, nreg=0, stop=0;
 
   /* Initialize... */
   los->np=0;
@@ -45,6 +46,22 @@ void raytrace(ctl_t *ctl,
   for(i=0; i<3; i++)
     ex0[i]/=norm;
   
+  /* Straight rays (no refraction)... */
+  if(!ctl->refrac) {
+    raytrace_straight(ctl, atm, obs, aero, los, ir, xobs, ex0, zmin, zmax);
+    return;
+  }
+  
+  /* Allocate... */
+  ALLOC(ireg, int, NLOS);
+  
+  /* Get altitudes to sample aerosol/cloud edges... */
+  if(ctl->sca_n>0) {
+    ALLOC(alti, double, NLOS);
+    ALLOC(dl, double, NLOS);
+    nalti=aerosol_altitudes(ctl, aero, alti);
+  }
+  
   /* Observer within atmosphere... */
   for(i=0; i<3; i++)
     x[i]=xobs[i];
@@ -56,7 +73,7 @@ void raytrace(ctl_t *ctl,
       d=(dmax+dmin)/2;
       for(i=0; i<3; i++)
 	x[i]=xobs[i]+d*ex0[i];
-      cart2geo(x, &z, &lon, &lat);
+      z=NORM(x)-RE;
       if(z<=zmax && z>zmax-0.001)
 	break;
       if(z<zmax-0.0005)
@@ -66,13 +83,21 @@ void raytrace(ctl_t *ctl,
     }
   }
   
+  /* Initialize previous LOS points... */
+  for(i=0; i<3; i++)
+    xl[i]=xp[i]=x[i];
+  
   /* Ray-tracing... */
   while(1) {
     
+    /* Get radial distance and altitude (lon/lat are only needed for
+       LOS points that are kept)... */
+    norm=NORM(x);
+    z=norm-RE;
+    
     /* Set step length... */
     ds=ctl->rayds;
     if(ctl->raydz>0) {
-      norm=NORM(x);
       for(i=0; i<3; i++)
 	xh[i]=x[i]/norm;
       cosa=fabs(DOTP(ex0, xh));
@@ -80,22 +105,44 @@ void raytrace(ctl_t *ctl,
 	ds=GSL_MIN(ctl->rayds, ctl->raydz/cosa);
     }
     
-    /* Determine geolocation... */
-    cart2geo(x, &z, &lon, &lat);
-    
-    /* Check if LOS hits the ground or has left atmosphere and save last los point. */
+    /* Check if LOS hits the ground or has left atmosphere... */
+    znew=z;
     if(z<zmin+0.001 || z>zmax+0.001) {
       stop=(z<zmin+0.001 ? 2 : 1);
-      los->z[los->np] = z;
-      los->lon[los->np]=lon;
-      los->lat[los->np]=lat;
-      intersection_point(ctl, atm, (z<zmin+0.001 ? &zmin : &zmax), los, los->np, los, los->np);
+      znew=(stop==2 ? zmin : zmax);
+    }
+    
+    /* Add LOS points where the last step crossed aerosol/cloud edges... */
+    if(los->np>0)
+      for(il=0; il<nalti; il++) {
+	zalt=(znew<zp ? alti[il] : alti[nalti-il-1]);
+	if((zp-zalt)*(znew-zalt)<0) {
+	  intersection_point(ctl, atm, xp, zp, x, z, zalt, los, los->np, xh);
+	  dl[los->np]=DIST(xl, xh);
+	  for(i=0; i<3; i++)
+	    xl[i]=xh[i];
+	  if((++los->np)>=NLOS)
+	    ERRMSG("Too many LOS points!");
+	}
+      }
+    
+    /* Save last los point (interpolate between geolocated end points to
+       match the tangent altitude of nadir rays of earlier versions)... */
+    if(stop) {
+      if(nreg>0) {
+	cart2geo(x, &z, &lon, &lat);
+	geo2cart(z, lon, lat, x);
+	ip=ireg[nreg-1];
+	geo2cart(los->z[ip], los->lon[ip], los->lat[ip], xp);
+      }
+      intersection_point(ctl, atm, xp, zp, x, z, znew, los, los->np, xh);
       los->ds[los->np]=0.;
     }
     
-    /* Save first and middle los points. */
-    if(stop==0) {
-      intpol_atm_geo(ctl, atm, z, lon, lat, &p, &t, q, k);
+    /* Save first and middle los points... */
+    else {
+      cart2geo(x, &z, &lon, &lat);
+      intpol_atm_geo(ctl, atm, z, lon, lat, &hint, &p, &t, q, k);
       
       los->lon[los->np]=lon;
       los->lat[los->np]=lat;
@@ -107,8 +154,23 @@ void raytrace(ctl_t *ctl,
       for(iw=0; iw<ctl->nw; iw++)
 	los->k[los->np][iw]=k[iw];
       los->ds[los->np]=ds;
+      for(i=0; i<3; i++)
+	xh[i]=x[i];
     }
-
+    
+    /* Keep track of distances between LOS points... */
+    if(dl) {
+      dl[los->np]=(los->np>0 ? DIST(xl, xh) : 0);
+      for(i=0; i<3; i++)
+	xl[i]=xh[i];
+    }
+    
+    /* Keep track of regular ray-tracing points... */
+    ireg[nreg++]=los->np;
+    for(i=0; i<3; i++)
+      xp[i]=x[i];
+    zp=z;
+    
     /* Increment and check number of LOS points... */
     if((++los->np)>NLOS)
       ERRMSG("Too many LOS points!");
@@ -133,13 +195,19 @@ void raytrace(ctl_t *ctl,
     if(ctl->refrac && z<=zrefrac) {
       for(i=0; i<3; i++)
 	xh[i]=x[i]+0.5*ds*ex0[i];
-      cart2geo(xh, &z, &lon, &lat);
-      intpol_atm_geo(ctl, atm, z, lon, lat, &p, &t, q, k);
+      if(ctl->ip==1)
+	z=NORM(xh)-RE;
+      else
+	cart2geo(xh, &z, &lon, &lat);
+      intpol_atm_geo(ctl, atm, z, lon, lat, &hint, &p, &t, q, k);
       n=refractivity(p, t);
       for(i=0; i<3; i++) {
 	xh[i]+=h;
-	cart2geo(xh, &z, &lon, &lat);
-	intpol_atm_geo(ctl, atm, z, lon, lat, &p, &t, q, k);
+	if(ctl->ip==1)
+	  z=NORM(xh)-RE;
+	else
+	  cart2geo(xh, &z, &lon, &lat);
+	intpol_atm_geo(ctl, atm, z, lon, lat, &hint, &p, &t, q, k);
 	naux=refractivity(p, t);
 	ng[i]=(naux-n)/h;
 	xh[i]-=h;
@@ -167,57 +235,65 @@ void raytrace(ctl_t *ctl,
   }
   
   /* Check length of last segment... */
-  if(los->ds[los->np-2]<1e-3 && los->np-1>1)
-    los->np--;
+  if(los->ds[ireg[nreg-2]]<1e-3 && nreg-1>1) {
+    los->np=ireg[nreg-2]+1;
+    nreg--;
+  }
   
   /* Get tangent point (to be done before changing segment lengths!)... */
-  tangent_point(los, &obs->tpz[ir], &obs->tplon[ir], &obs->tplat[ir]);
+  tangent_point(los, ireg, nreg,
+		&obs->tpz[ir], &obs->tplon[ir], &obs->tplat[ir]);
   
   /* Change segment lengths according to trapezoid rule... */
-  los->ds[0]=0.5*los->ds[0];
-  for(ip=1; ip<los->np; ip++)
-    los->ds[ip]=0.5*(los->ds[ip-1]+los->ds[ip]);
-
-  /* Compute column density... */
-  for(ip=0; ip<los->np; ip++)
+  if(dl)
+    for(ip=0; ip<los->np; ip++)
+      los->ds[ip]=0.5*((ip>0 ? dl[ip] : 0)+(ip<los->np-1 ? dl[ip+1] : 0));
+  else {
+    los->ds[0]=0.5*los->ds[0];
+    for(ip=1; ip<los->np; ip++)
+      los->ds[ip]=0.5*(los->ds[ip-1]+los->ds[ip]);
+  }
+  
+  /* Compute column density and get aerosol/cloud data... */
+  for(ip=0; ip<los->np; ip++) {
     for(ig=0; ig<ctl->ng; ig++)
       los->u[ip][ig]=10*los->q[ip][ig]*los->p[ip]
 	/(GSL_CONST_MKSA_BOLTZMANN*los->t[ip])*los->ds[ip];
-
-  /* Add additional los points for aerosol layers and add aerosol data */
-  if (ctl->sca_n > 0)
-    add_aerosol_layers(ctl,atm,los,aero);
+    aerosol_factor(ctl, aero, los->z[ip], &los->aeroi[ip], &los->aerofac[ip]);
+    los->mirror[ip]=-1;
+  }
+  
+  /* Free... */
+  free(ireg);
+  if(dl) {
+    free(alti);
+    free(dl);
+  }
 }
 
 /*****************************************************************************/
-void add_aerosol_layers(ctl_t *ctl,
-			atm_t *atm,
-			los_t *los,
-			aero_t *aero){
 
-  los_t *los_aero;
-
-  double alti[4*NLMAX], altimax, altimin, x1[3], x2[3], x3[3], tt=0., epsilon=0.005; 
-  /* deltatop=10., deltabot=10., */
-
-  int il, ig, iw, jl=0, ip, it;
-
-  size_t s;
-
-  /* Allocate extended los... */
-  ALLOC(los_aero, los_t, 1);
-
-  /* Create altitudes to sample aerosol edges */
-  for (il=0; il<aero->nl;il++){
+int aerosol_altitudes(ctl_t *ctl,
+		      aero_t *aero,
+		      double *alti) {
+  
+  double tt, epsilon=0.005;
+  
+  int il, it, jl=0;
+  
+  /* Create altitudes to sample aerosol edges... */
+  for(il=0; il<aero->nl; il++) {
     alti[jl] = aero->top[il] + epsilon;
     alti[jl+1] = aero->top[il] - epsilon;
     alti[jl+2] = aero->bottom[il] + epsilon;
     alti[jl+3] = aero->bottom[il] - epsilon;
     jl = jl+4;
-
-    /* Create altitudes to sample transition layers */
+    
+    /* Create altitudes to sample transition layers... */
     if (aero->trans[il] > ctl->transs) {
       tt = aero->trans[il] / ctl->transs;
+      if(jl+2*(int)tt+2>NLOS)
+	ERRMSG("Too many altitudes for transition layers!");
       
       alti[jl] = aero->top[il] + aero->trans[il] + epsilon;
       alti[jl+1] = aero->top[il] + aero->trans[il] - epsilon;
@@ -230,145 +306,51 @@ void add_aerosol_layers(ctl_t *ctl,
 	alti[jl] = aero->bottom[il] - aero->trans[il] + epsilon + it*ctl->transs;
 	jl++;
       }
-    }  
+    }
   }
-
-  /* Sort all altitudes from top-down */
+  
+  /* Sort all altitudes from top-down... */
   for (il=0; il<jl;il++)
     alti[il]=alti[il]*(-1.);
   gsl_sort(alti,1,(size_t)jl);
   for (il=0; il<jl;il++)
     alti[il]=alti[il]*(-1.);
   
-  altimax = gsl_stats_max(alti, 1, (size_t)jl);
-  altimin = gsl_stats_min(alti, 1, (size_t)jl);
+  return jl;
+}
 
-  /* Copy los to new los and add additional points */
-  los_aero->tsurf = los->tsurf;
-  los_aero->z[0] = los->z[0];
-  los_aero->lat[0] = los->lat[0];
-  los_aero->lon[0] = los->lon[0];
-  los_aero->ds[0] = los->ds[0];  
-  los_aero->t[0] = los->t[0];
-  los_aero->p[0] = los->p[0];
-  for(ig=0; ig<ctl->ng; ig++)
-    los_aero->q[0][ig] = los->q[0][ig];
-  for(iw=0; iw<ctl->nw; iw++)
-    los_aero->k[0][iw] = los->k[0][iw];
-  los_aero->np = 1;
+/*****************************************************************************/
 
-  for (ip=1; ip<los->np; ip++){
-    
-    /* add new los points around cloud edges */
-    if ( (los->z[ip-1] < altimax || los->z[ip] < altimax) &&
-	 (los->z[ip-1] > altimin || los->z[ip] > altimin) ) { 
-      for (il=0; il<jl;il++){ /* loop over cloud edges */
-	/* von oben */
-	if(los->z[ip-1] > alti[il] && los->z[ip] < alti[il]){
-	  intersection_point(ctl, atm, &alti[il], los, ip, los_aero, los_aero->np);
-	  los_aero->np++; 
-	}
-	/* von unten */
-	if(los->z[ip-1] < alti[jl-il-1] && los->z[ip] > alti[jl-il-1]){
-	  intersection_point(ctl, atm, &alti[jl-il-1], los, ip, los_aero, los_aero->np);
-	  los_aero->np++;
-	}
-      }
+void aerosol_factor(ctl_t *ctl,
+		    aero_t *aero,
+		    double z,
+		    int *aeroi,
+		    double *aerofac) {
+  
+  int il;
+  
+  /* Outside of aerosol/cloud layers... */
+  *aeroi = -999;
+  *aerofac = 0.;
+  
+  for (il=0; il<aero->nl;il++){
+    /* Aerosol info within layer centre */
+    if (z <= aero->top[il] && z >= aero->bottom[il]){
+      *aeroi = il;
+      *aerofac = 1.;
     }
-
-    /* /\* check if current altitude is closer than 2m *\/ */
-    /* /\* to any cloud top or bottom *\/ */
-    /* deltatop = 10; */
-    /* deltabot = 10; */
-    /* for (il=0; il<aero->nl;il++){ */
-    /*   deltatop = fabs(los->z[ip] - aero->top[il]); */
-    /*   deltabot = fabs(los->z[ip] - aero->bottom[il]); */
-    /*   if ( deltatop < epsilon*2. || deltabot < epsilon*2. ){ */
-    /* 	continue; */
-    /*   } */
-    /* } */
-    
-    /* only copy old los points, if they are outside top||bottom +-2m */ 
-    /* if ( deltatop >= epsilon*2. && deltabot >= epsilon*2. ) {  */
-    /* copy old los points */
-    los_aero->z[los_aero->np] = los->z[ip];
-    los_aero->lat[los_aero->np] = los->lat[ip];
-    los_aero->lon[los_aero->np] = los->lon[ip];
-    los_aero->t[los_aero->np] = los->t[ip];
-    los_aero->p[los_aero->np] = los->p[ip];
-    for(ig=0; ig<ctl->ng; ig++)
-      los_aero->q[los_aero->np][ig] = los->q[ip][ig];
-    for(iw=0; iw<ctl->nw; iw++)
-      los_aero->k[los_aero->np][iw] = los->k[ip][iw];
-    
-    /* Increment and check number of new LOS points */
-    if((los_aero->np++)>NLOS)
-      ERRMSG("Too many LOS points!");
-    /* } */
-  }
-
-  /* Compute segment length following trapezoidal rule */
-  geo2cart(los_aero->z[0], los_aero->lon[0],los_aero->lat[0], x1);
-  geo2cart(los_aero->z[1], los_aero->lon[1],los_aero->lat[1], x2);
-  los_aero->ds[0]= 0.5 * (DIST(x1,x2));
-  for(ip=1; ip<los_aero->np-1; ip++){
-    geo2cart(los_aero->z[ip-1], los_aero->lon[ip-1],los_aero->lat[ip-1], x1);
-    geo2cart(los_aero->z[ip], los_aero->lon[ip],los_aero->lat[ip], x2);
-    geo2cart(los_aero->z[ip+1], los_aero->lon[ip+1],los_aero->lat[ip+1], x3);
-    los_aero->ds[ip] = 0.5 * (DIST(x1,x2) + DIST(x2,x3));
-  }
-  geo2cart(los_aero->z[los_aero->np-1], los_aero->lon[los_aero->np-1], 
-	   los_aero->lat[los_aero->np-1], x1);
-  geo2cart(los_aero->z[los_aero->np-2], los_aero->lon[los_aero->np-2], 
-	   los_aero->lat[los_aero->np-2], x2);
-  los_aero->ds[los_aero->np-1] = 0.5 * (DIST(x1,x2));
-
-  /* add aerosol/cloud information and column density u to new los  */
-  for (ip=0; ip<los_aero->np; ip++){
-
-    /* Compute column density... */
-    for(ig=0; ig<ctl->ng; ig++)
-      los_aero->u[ip][ig]=10*los_aero->q[ip][ig]*los_aero->p[ip]
-	/(GSL_CONST_MKSA_BOLTZMANN*los_aero->t[ip])*los_aero->ds[ip];
-
-    /* Get aerosol/cloud layer id and factor */
-    los_aero->aeroi[ip] = -999;
-    los_aero->aerofac[ip] = 0.;
-    if ( (los_aero->z[ip-1] < altimax || los_aero->z[ip] < altimax) &&
-	 (los_aero->z[ip-1] > altimin || los_aero->z[ip] > altimin) ) { 
-      for (il=0; il<aero->nl;il++){
-        /* Aerosol info within layer centre */
-	if (los_aero->z[ip] <= aero->top[il] && 
-	    los_aero->z[ip] >= aero->bottom[il]){
-	  los_aero->aeroi[ip] = il;
-	  los_aero->aerofac[ip] = 1.;	  
-	}
-	/* Aerosol info in transition region */
-	if (aero->trans[il] > ctl->transs &&
-	    los_aero->z[ip] <= (aero->top[il] + aero->trans[il]) &&
-	    los_aero->z[ip] > aero->top[il]){
-	  los_aero->aeroi[ip] = il;
-	  los_aero->aerofac[ip] = (aero->top[il] + aero->trans[il] - los_aero->z[ip])/
-	    aero->trans[il];
-	}
-	if (aero->trans[il] > ctl->transs &&
-	    los_aero->z[ip] < aero->bottom[il] &&
-	    los_aero->z[ip] >= (aero->bottom[il] - aero->trans[il])){
-	  los_aero->aeroi[ip] = il;
-	  los_aero->aerofac[ip] = fabs(aero->bottom[il]-aero->trans[il]-los_aero->z[ip])/
-	    aero->trans[il];
-	}
-      }
+    /* Aerosol info in transition region */
+    if (aero->trans[il] > ctl->transs &&
+	z <= (aero->top[il] + aero->trans[il]) && z > aero->top[il]){
+      *aeroi = il;
+      *aerofac = (aero->top[il] + aero->trans[il] - z)/aero->trans[il];
+    }
+    if (aero->trans[il] > ctl->transs &&
+	z < aero->bottom[il] && z >= (aero->bottom[il] - aero->trans[il])){
+      *aeroi = il;
+      *aerofac = fabs(aero->bottom[il]-aero->trans[il]-z)/aero->trans[il];
     }
   }
-
-  /* Copy los */
-  /*   *los = *los_aero; */
-  s=sizeof(los_t);
-  memcpy(los, los_aero, s);
-   
-  /* Free help los... */
-  free(los_aero);
 }
 
 /*****************************************************************************/
@@ -384,44 +366,52 @@ double refractivity(double p,
 
 void intersection_point(ctl_t *ctl,
 			atm_t *atm,
-			double *znew,
+			double *x0,
+			double z0,
+			double *x1,
+			double z1,
+			double znew,
 			los_t *los,
 			int ip,
-			los_t *los_aero,
-			int jp){
+			double *x) {
   
-  double frac, x1[3], x2[3];
-  int i ;
+  double frac;
+  int i;
   
-  frac = (los->z[ip-1] - *znew) / (los->z[ip-1] - los->z[ip]);
-  geo2cart(los->z[ip-1], los->lon[ip-1], los->lat[ip-1], x1);
-  geo2cart(los->z[ip], los->lon[ip], los->lat[ip], x2);
-
+  /* Interpolate linearly in altitude along the segment... */
+  frac = (z0 - znew) / (z0 - z1);
   for(i=0; i<3; i++)
-    x2[i]=x1[i]+frac*(x2[i]-x1[i]);
-  /* get new coordinates */
-  cart2geo(x2, &los_aero->z[jp], &los_aero->lon[jp], &los_aero->lat[jp]);
-  /* get atmosphere parameters */
-  intpol_atm_geo(ctl, atm, los_aero->z[jp], los_aero->lon[jp], los_aero->lat[jp],
-		 &los_aero->p[jp], &los_aero->t[jp], los_aero->q[jp], los_aero->k[jp]);
+    x[i]=x0[i]+frac*(x1[i]-x0[i]);
+  
+  /* Get new coordinates... */
+  cart2geo(x, &los->z[ip], &los->lon[ip], &los->lat[ip]);
+  
+  /* Get atmosphere parameters... */
+  intpol_atm_geo(ctl, atm, los->z[ip], los->lon[ip], los->lat[ip], NULL,
+		 &los->p[ip], &los->t[ip], los->q[ip], los->k[ip]);
 }
 
 /*****************************************************************************/
 
 void tangent_point(los_t *los,
+		   int *ireg,
+		   int nreg,
 		   double *tpz,
 		   double *tplon,
 		   double *tplat) {
   
   double a, b, c, dummy, v[3], v0[3], v2[3], x, x1, x2, yy0, yy1, yy2;
   
-  size_t i, ip;
+  int i, ip, jp;
   
   /* Find minimum altitude... */
-  ip=gsl_stats_min_index(los->z, 1, (size_t)los->np);
+  jp=0;
+  for(ip=1; ip<nreg; ip++)
+    if(los->z[ireg[ip]]<los->z[ireg[jp]])
+      jp=ip;
   
   /* Nadir or zenith... */
-  if(ip<=0 || ip>=(size_t)los->np-1) {
+  if(jp<=0 || jp>=nreg-1) {
     *tpz=los->z[los->np-1];
     *tplon=los->lon[los->np-1];
     *tplat=los->lat[los->np-1];
@@ -431,11 +421,11 @@ void tangent_point(los_t *los,
   else {
     
     /* Determine interpolating polynomial y=a*x^2+b*x+c... */
-    yy0=los->z[ip-1];
-    yy1=los->z[ip];
-    yy2=los->z[ip+1];
-    x1=sqrt(gsl_pow_2(los->ds[ip])-gsl_pow_2(yy1-yy0));
-    x2=x1+sqrt(gsl_pow_2(los->ds[ip+1])-gsl_pow_2(yy2-yy1));
+    yy0=los->z[ireg[jp-1]];
+    yy1=los->z[ireg[jp]];
+    yy2=los->z[ireg[jp+1]];
+    x1=sqrt(gsl_pow_2(los->ds[ireg[jp]])-gsl_pow_2(yy1-yy0));
+    x2=x1+sqrt(gsl_pow_2(los->ds[ireg[jp+1]])-gsl_pow_2(yy2-yy1));
     a=1/(x1-x2)*(-(yy0-yy1)/x1+(yy0-yy2)/x2);
     b=-(yy0-yy1)/x1-a*x1;
     c=yy0;
@@ -443,10 +433,199 @@ void tangent_point(los_t *los,
     /* Get tangent point location... */
     x=-b/(2*a);
     *tpz=a*x*x+b*x+c;
-    geo2cart(los->z[ip-1], los->lon[ip-1], los->lat[ip-1], v0);
-    geo2cart(los->z[ip+1], los->lon[ip+1], los->lat[ip+1], v2);
+    ip=ireg[jp-1];
+    geo2cart(los->z[ip], los->lon[ip], los->lat[ip], v0);
+    ip=ireg[jp+1];
+    geo2cart(los->z[ip], los->lon[ip], los->lat[ip], v2);
     for(i=0; i<3; i++)
       v[i]=LIN(0.0, v0[i], x2, v2[i], x);
     cart2geo(v, &dummy, tplon, tplat);
   }
 }
+
+/*****************************************************************************/
+
+void raytrace_straight(ctl_t *ctl,
+		       atm_t *atm,
+		       obs_t *obs,
+		       aero_t *aero,
+		       los_t *los,
+		       int ir,
+		       double *xobs,
+		       double *ex,
+		       double zmin,
+		       double zmax) {
+  
+  double b, c, d, dr, r0, r1, *s, *sp, smax, smin, st, x[3], *zs;
+  
+  int hint=-1, i, ig, ip, is, iw, j, n, ns, nz, stop=1, sym;
+  
+  /* Ray points x=xobs+s*ex have squared radius c+2*b*s+s^2... */
+  b=DOTP(xobs, ex);
+  c=DOTP(xobs, xobs);
+  
+  /* Get entry point (observer above atmosphere)... */
+  d=b*b-c+gsl_pow_2(RE+zmax);
+  if(obs->obsz[ir]>zmax) {
+    if(d<=0 || -b-sqrt(d)<0)
+      return;
+    smin=-b-sqrt(d);
+  } else
+    smin=0;
+  
+  /* Get exit point (ground or top of atmosphere)... */
+  smax=-b+sqrt(GSL_MAX(d, 0));
+  d=b*b-c+gsl_pow_2(RE+zmin);
+  if(d>0 && -b-sqrt(d)>smin) {
+    smax=-b-sqrt(d);
+    stop=2;
+  }
+  
+  /* Allocate... */
+  ALLOC(s, double, NLOS);
+  ALLOC(sp, double, NLOS);
+  ALLOC(zs, double, NLOS+NPMAX);
+  
+  /* Collect altitudes of atmospheric grid and aerosol/cloud edges... */
+  nz=0;
+  for(ip=0; ip<atm->np; ip++)
+    if(atm->z[ip]>zmin && atm->z[ip]<zmax)
+      zs[nz++]=atm->z[ip];
+  if(ctl->sca_n>0) {
+    j=nz;
+    n=aerosol_altitudes(ctl, aero, &zs[j]);
+    for(i=j; i<j+n; i++)
+      if(zs[i]>zmin && zs[i]<zmax)
+	zs[nz++]=zs[i];
+  }
+  gsl_sort(zs, 1, (size_t)nz);
+  
+  /* Intersect ray with spherical shells (keep room for tangent point
+     and symmetric points)... */
+  ns=0;
+  s[ns++]=smin;
+  s[ns++]=smax;
+  for(i=0; i<nz; i++)
+    if(i==0 || zs[i]>zs[i-1]) {
+      d=b*b-c+gsl_pow_2(RE+zs[i]);
+      if(d>0)
+	for(j=-1; j<=1; j+=2)
+	  if(-b+j*sqrt(d)>smin && -b+j*sqrt(d)<smax) {
+	    if(ns>=NLOS-3)
+	      ERRMSG("Too many LOS points!");
+	    s[ns++]=-b+j*sqrt(d);
+	  }
+    }
+  
+  /* Add tangent point... */
+  st=-b;
+  if(st>smin && st<smax)
+    s[ns++]=st;
+  
+  /* Sample symmetrically around the tangent point (1D atmosphere)... */
+  sym=(ctl->ip==1 && st>smin && st<smax);
+  if(sym) {
+    if(2*st-smin<smax)
+      s[ns++]=2*st-smin;
+    if(2*st-smax>smin)
+      s[ns++]=2*st-smax;
+  }
+  
+  /* Sort intersections and remove points closer than 1 m... */
+  gsl_sort(s, 1, (size_t)ns);
+  n=1;
+  for(is=1; is<ns-1; is++)
+    if(s[is]-s[n-1]>1e-3 && smax-s[is]>1e-3)
+      s[n++]=s[is];
+  s[n++]=smax;
+  
+  /* Refine segments according to RAYDS and RAYDZ... */
+  ns=0;
+  for(is=0; is<n-1; is++) {
+    r0=sqrt(c+2*b*s[is]+s[is]*s[is]);
+    r1=sqrt(c+2*b*s[is+1]+s[is+1]*s[is+1]);
+    dr=(ctl->raydz>0 ? fabs(r1-r0)/ctl->raydz : 0);
+    j=(int)ceil(GSL_MAX(GSL_MAX((s[is+1]-s[is])/ctl->rayds, dr), 1));
+    if(ns+j>=NLOS)
+      ERRMSG("Too many LOS points!");
+    for(i=0; i<j; i++)
+      sp[ns++]=s[is]+i*(s[is+1]-s[is])/j;
+  }
+  sp[ns++]=smax;
+  
+  /* Find mirrored LOS points behind the tangent point... */
+  for(ip=0; ip<ns; ip++)
+    los->mirror[ip]=-1;
+  if(sym) {
+    j=0;
+    while(j<ns-1 && sp[j+1]<=st)
+      j++;
+    for(ip=j+1; ip<ns; ip++) {
+      while(j>0 && sp[j]>2*st-sp[ip]+1e-6)
+	j--;
+      if(fabs(sp[j]-(2*st-sp[ip]))<=1e-6 && sp[j]<st)
+	los->mirror[ip]=j;
+    }
+  }
+  
+  /* Save LOS points... */
+  for(ip=0; ip<ns; ip++) {
+    for(i=0; i<3; i++)
+      x[i]=xobs[i]+sp[ip]*ex[i];
+    cart2geo(x, &los->z[ip], &los->lon[ip], &los->lat[ip]);
+    
+    /* Copy atmospheric data of mirrored point... */
+    if((j=los->mirror[ip])>=0) {
+      los->z[ip]=los->z[j];
+      los->p[ip]=los->p[j];
+      los->t[ip]=los->t[j];
+      for(ig=0; ig<ctl->ng; ig++)
+	los->q[ip][ig]=los->q[j][ig];
+      for(iw=0; iw<ctl->nw; iw++)
+	los->k[ip][iw]=los->k[j][iw];
+    }
+    
+    /* Interpolate atmospheric data... */
+    else
+      intpol_atm_geo(ctl, atm, los->z[ip], los->lon[ip], los->lat[ip],
+		     &hint, &los->p[ip], &los->t[ip], los->q[ip], los->k[ip]);
+  }
+  los->np=ns;
+  
+  /* Get segment lengths according to trapezoid rule... */
+  for(ip=0; ip<los->np; ip++)
+    los->ds[ip]=0.5*((ip>0 ? sp[ip]-sp[ip-1] : 0)
+		     +(ip<los->np-1 ? sp[ip+1]-sp[ip] : 0));
+  
+  /* Compute column density and get aerosol/cloud data... */
+  for(ip=0; ip<los->np; ip++) {
+    for(ig=0; ig<ctl->ng; ig++)
+      los->u[ip][ig]=10*los->q[ip][ig]*los->p[ip]
+	/(GSL_CONST_MKSA_BOLTZMANN*los->t[ip])*los->ds[ip];
+    if((j=los->mirror[ip])>=0) {
+      los->aeroi[ip]=los->aeroi[j];
+      los->aerofac[ip]=los->aerofac[j];
+    } else
+      aerosol_factor(ctl, aero, los->z[ip],
+		     &los->aeroi[ip], &los->aerofac[ip]);
+  }
+  
+  /* Set surface temperature... */
+  los->tsurf=(stop==2 ? los->t[los->np-1] : -999);
+  
+  /* Get tangent point (limb) or last LOS point (nadir/zenith)... */
+  if(st>smin && st<smax) {
+    for(i=0; i<3; i++)
+      x[i]=xobs[i]+st*ex[i];
+    cart2geo(x, &obs->tpz[ir], &obs->tplon[ir], &obs->tplat[ir]);
+  } else {
+    obs->tpz[ir]=los->z[los->np-1];
+    obs->tplon[ir]=los->lon[los->np-1];
+    obs->tplat[ir]=los->lat[los->np-1];
+  }
+  
+  /* Free... */
+  free(s);
+  free(sp);
+  free(zs);
+}
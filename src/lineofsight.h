@@ -12,29 +12,52 @@ void raytrace(ctl_t *ctl,
 	      los_t *los,
 	      int ir);
 
+/* Do ray-tracing for straight rays (no refraction). */
+void raytrace_straight(ctl_t *ctl,
+		       atm_t *atm,
+		       obs_t *obs,
+		       aero_t *aero,
+		       los_t *los,
+		       int ir,
+		       double *xobs,
+		       double *ex,
+		       double zmin,
+		       double zmax);
+
+/* Get altitudes for sampling of aerosol/cloud edges (sorted top-down). */
+int aerosol_altitudes(ctl_t *ctl,
+		      aero_t *aero,
+		      double *alti);
+
+/* Get aerosol/cloud layer index and scaling factor at given altitude. */
+void aerosol_factor(ctl_t *ctl,
+		    aero_t *aero,
+		    double z,
+		    int *aeroi,
+		    double *aerofac);
+
 /* Compute refractivity (return value is n - 1). */
 double refractivity(double p,
 		    double t);
 
-/* Find tangent point of a given LOS. */
+/* Find tangent point of a given LOS (from regular ray-tracing points). */
 void tangent_point(los_t *los,
+		   int *ireg,
+		   int nreg,
 		   double *tpz,
 		   double *tplon,
 		   double *tplat);
 
-/* Find ground or TOA intersection point of a LOS. */
+/* Find intersection point of a LOS segment with a given altitude. */
 void intersection_point(ctl_t *ctl,
 			atm_t *atm,
-			double *znew,
+			double *x0,
+			double z0,
+			double *x1,
+			double z1,
+			double znew,
 			los_t *los,
 			int ip,
-			los_t *los_aero,
-			int jp);
-
-/* Add points to LOS for fine sampling of aerosol/cloud layers. */
-void add_aerosol_layers(ctl_t *ctl,
-			atm_t *atm,
-			los_t *los,
-			aero_t *aero);
+			double *x);
 
 #endif
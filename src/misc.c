@@ -81,7 +81,7 @@ void init_tbl(ctl_t *ctl,
   char filename[2*LEN], line[LEN];
   
   double eps, eps_old, press, press_old, temp, temp_old, u, u_old,
-    f[NSHAPE], fsum, nu[NSHAPE], tmin=100, tmax=400;
+    f[NSHAPE], fsum, nu[NSHAPE], tmin=100, tmax=400, val[4];
   
   int i, id, ig, ip, it, n;
   
@@ -146,8 +146,12 @@ void init_tbl(ctl_t *ctl,
 	while(fgets(line, LEN, in)) {
 	  
 	  /* Parse line... */
-	  if(sscanf(line,"%lg %lg %lg %lg", &press, &temp, &u, &eps)!=4)
+	  if(scan_doubles(line, val, 4)!=4)
 	    continue;
+	  press=val[0];
+	  temp=val[1];
+	  u=val[2];
+	  eps=val[3];
 	  
 	  /* Determine pressure index... */
 	  if(press!=press_old) {
@@ -266,6 +270,135 @@ int locate(double *xx,
 
 /*****************************************************************************/
 
+int locate_hint(double *xx,
+		int n,
+		double x,
+		int ilo) {
+  
+  /* Check hint... */
+  if(ilo<0)
+    return locate(xx, n, x);
+  ilo=GSL_MIN_INT(ilo, n-2);
+  
+  /* Walk from previous index (same result as locate)... */
+  if(xx[(n-1)>>1]<xx[((n-1)>>1)+1]) {
+    while(ilo>0 && xx[ilo]>x)
+      ilo--;
+    while(ilo<n-2 && xx[ilo+1]<=x)
+      ilo++;
+  } else {
+    while(ilo>0 && xx[ilo]<=x)
+      ilo--;
+    while(ilo<n-2 && xx[ilo+1]>x)
+      ilo++;
+  }
+  
+  return ilo;
+}
+
+/*****************************************************************************/
+
+int locate_reg(double *xx,
+	       int n,
+	       double x) {
+  
+  int i;
+  
+  /* Calculate index... */
+  i=(int)floor((x-xx[0])/(xx[1]-xx[0]));
+  
+  /* Check range... */
+  if(i<0)
+    return 0;
+  else if(i>n-2)
+    return n-2;
+  else
+    return i;
+}
+
+/*****************************************************************************/
+
+int scan_doubles(const char *s,
+		 double *x,
+		 int n) {
+  
+  const double pow10[23]={1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+			  1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+			  1e18, 1e19, 1e20, 1e21, 1e22};
+  
+  const char *c;
+  
+  unsigned long long m;
+  
+  int e, es, i, nc, nd, nf, neg;
+  
+  /* Loop over values... */
+  for(i=0; i<n; i++) {
+    
+    /* Skip white space... */
+    while(isspace((unsigned char)*s))
+      s++;
+    if(*s=='\0')
+      return i;
+    
+    /* Get sign... */
+    c=s;
+    neg=(*c=='-');
+    if(*c=='-' || *c=='+')
+      c++;
+    
+    /* Get digits of mantissa... */
+    m=0;
+    nd=nf=0;
+    while(isdigit((unsigned char)*c) && nd<=15) {
+      m=10*m+(unsigned long long)(*c++-'0');
+      nd++;
+    }
+    if(*c=='.') {
+      c++;
+      while(isdigit((unsigned char)*c) && nd<=15) {
+	m=10*m+(unsigned long long)(*c++-'0');
+	nd++;
+	nf++;
+      }
+    }
+    
+    /* Get exponent... */
+    e=0;
+    if(nd>0 && (*c=='e' || *c=='E')) {
+      c++;
+      es=(*c=='-' ? -1 : 1);
+      if(*c=='-' || *c=='+')
+	c++;
+      if(!isdigit((unsigned char)*c))
+	nd=99;
+      while(isdigit((unsigned char)*c) && e<1000)
+	e=10*e+(*c++-'0');
+      e*=es;
+    }
+    e-=nf;
+    
+    /* Fast conversion (exact operands, single rounding)... */
+    if(nd>0 && nd<=15 && e>=-22 && e<=22
+       && (*c=='\0' || isspace((unsigned char)*c))) {
+      x[i]=(e>=0 ? (double)m*pow10[e] : (double)m/pow10[-e]);
+      if(neg)
+	x[i]=-x[i];
+      s=c;
+    }
+    
+    /* Use library conversion otherwise... */
+    else if(sscanf(s, "%lg%n", &x[i], &nc)==1)
+      s+=nc;
+    else
+      return i;
+  }
+  
+  return n;
+}
+
+/*****************************************************************************/
+
 void read_obs(const char *dirname,
 	      const char *filename,
 	      ctl_t *ctl,
@@ -273,7 +406,7 @@ void read_obs(const char *dirname,
   
   FILE *in;
   
-  char file[LEN], line[LEN], *tok;
+  char file[LEN], line[LEN], magic[4], *tok;
   
   int id;
   
@@ -293,28 +426,35 @@ void read_obs(const char *dirname,
   if(!(in=fopen(file, "r")))
     ERRMSG("Cannot open file!");
   
-  /* Read data... */
-  while(fgets(line, LEN, in)) {
-    
-    /* Read data... */
-    TOK(line, tok, "%lg", obs->time[obs->nr]);
-    TOK(NULL, tok, "%lg", obs->obsz[obs->nr]);
-    TOK(NULL, tok, "%lg", obs->obslon[obs->nr]);
-    TOK(NULL, tok, "%lg", obs->obslat[obs->nr]);
-    TOK(NULL, tok, "%lg", obs->vpz[obs->nr]);
-    TOK(NULL, tok, "%lg", obs->vplon[obs->nr]);
-    TOK(NULL, tok, "%lg", obs->vplat[obs->nr]);
-    TOK(NULL, tok, "%lg", obs->tpz[obs->nr]);
-    TOK(NULL, tok, "%lg", obs->tplon[obs->nr]);
-    TOK(NULL, tok, "%lg", obs->tplat[obs->nr]);
-    for(id=0; id<ctl->nd; id++)
-      TOK(NULL, tok, "%lg", obs->rad[id][obs->nr]);
-    for(id=0; id<ctl->nd; id++)
-      TOK(NULL, tok, "%lg", obs->tau[id][obs->nr]);
-    
-    /* Increment counter... */
-    if((++obs->nr)>NRMAX)
-      ERRMSG("Too many rays!");
+  /* Read binary data... */
+  if(fread(magic, 1, 4, in)==4 && memcmp(magic, "JOBS", 4)==0)
+    read_obs_bin(in, ctl, obs);
+  
+  /* Read ASCII data... */
+  else {
+    rewind(in);
+    while(fgets(line, LEN, in)) {
+      
+      /* Read data... */
+      TOKD(line, tok, obs->time[obs->nr]);
+      TOKD(NULL, tok, obs->obsz[obs->nr]);
+      TOKD(NULL, tok, obs->obslon[obs->nr]);
+      TOKD(NULL, tok, obs->obslat[obs->nr]);
+      TOKD(NULL, tok, obs->vpz[obs->nr]);
+      TOKD(NULL, tok, obs->vplon[obs->nr]);
+      TOKD(NULL, tok, obs->vplat[obs->nr]);
+      TOKD(NULL, tok, obs->tpz[obs->nr]);
+      TOKD(NULL, tok, obs->tplon[obs->nr]);
+      TOKD(NULL, tok, obs->tplat[obs->nr]);
+      for(id=0; id<ctl->nd; id++)
+	TOKD(NULL, tok, obs->rad[id][obs->nr]);
+      for(id=0; id<ctl->nd; id++)
+	TOKD(NULL, tok, obs->tau[id][obs->nr]);
+      
+      /* Increment counter... */
+      if((++obs->nr)>NRMAX)
+	ERRMSG("Too many rays!");
+    }
   }
   
   /* Close file... */
@@ -327,6 +467,55 @@ void read_obs(const char *dirname,
 
 /*****************************************************************************/
 
+void read_obs_bin(FILE *in,
+		  ctl_t *ctl,
+		  obs_t *obs) {
+  
+  double nu;
+  
+  int id, n;
+  
+  /* Check version... */
+  FREAD(&n, int, 1, in);
+  if(n!=1)
+    ERRMSG("Unknown version of binary data!");
+  
+  /* Check channels... */
+  FREAD(&n, int, 1, in);
+  if(n!=ctl->nd)
+    ERRMSG("Number of channels does not match control parameters!");
+  FREAD(&n, int, 1, in);
+  for(id=0; id<ctl->nd; id++) {
+    FREAD(&nu, double, 1, in);
+    if(nu!=ctl->nu[id])
+      ERRMSG("Channels do not match control parameters!");
+  }
+  
+  /* Get number of rays... */
+  FREAD(&obs->nr, int, 1, in);
+  FREAD(&n, int, 1, in);
+  if(obs->nr>NRMAX)
+    ERRMSG("Too many rays!");
+  
+  /* Read data... */
+  FREAD(obs->time, double, obs->nr, in);
+  FREAD(obs->obsz, double, obs->nr, in);
+  FREAD(obs->obslon, double, obs->nr, in);
+  FREAD(obs->obslat, double, obs->nr, in);
+  FREAD(obs->vpz, double, obs->nr, in);
+  FREAD(obs->vplon, double, obs->nr, in);
+  FREAD(obs->vplat, double, obs->nr, in);
+  FREAD(obs->tpz, double, obs->nr, in);
+  FREAD(obs->tplon, double, obs->nr, in);
+  FREAD(obs->tplat, double, obs->nr, in);
+  for(id=0; id<ctl->nd; id++)
+    FREAD(obs->rad[id], double, obs->nr, in);
+  for(id=0; id<ctl->nd; id++)
+    FREAD(obs->tau[id], double, obs->nr, in);
+}
+
+/*****************************************************************************/
+
 void write_obs(const char *dirname,
 	       const char *filename,
 	       ctl_t *ctl,
@@ -351,6 +540,13 @@ void write_obs(const char *dirname,
   if(!(out=fopen(file, "w")))
     ERRMSG("Cannot create file!");
   
+  /* Write binary data... */
+  if(ctl->obsfmt==2) {
+    write_obs_bin(out, ctl, obs);
+    fclose(out);
+    return;
+  }
+  
   /* Write header... */
   fprintf(out,
 	  "# $1 = time (seconds since 2000-01-01T00:00Z)\n"
@@ -389,3 +585,39 @@ void write_obs(const char *dirname,
   fclose(out);
 }
 
+/*****************************************************************************/
+
+void write_obs_bin(FILE *out,
+		   ctl_t *ctl,
+		   obs_t *obs) {
+  
+  int id, n;
+  
+  /* Write header... */
+  FWRITE("JOBS", char, 4, out);
+  n=1;
+  FWRITE(&n, int, 1, out);
+  FWRITE(&ctl->nd, int, 1, out);
+  n=0;
+  FWRITE(&n, int, 1, out);
+  FWRITE(ctl->nu, double, ctl->nd, out);
+  FWRITE(&obs->nr, int, 1, out);
+  FWRITE(&n, int, 1, out);
+  
+  /* Write data... */
+  FWRITE(obs->time, double, obs->nr, out);
+  FWRITE(obs->obsz, double, obs->nr, out);
+  FWRITE(obs->obslon, double, obs->nr, out);
+  FWRITE(obs->obslat, double, obs->nr, out);
+  FWRITE(obs->vpz, double, obs->nr, out);
+  FWRITE(obs->vplon, double, obs->nr, out);
+  FWRITE(obs->vplat, double, obs->nr, out);
+  FWRITE(obs->tpz, double, obs->nr, out);
+  FWRITE(obs->tplon, double, obs->nr, out);
+  FWRITE(obs->tplat, double, obs->nr, out);
+  for(id=0; id<ctl->nd; id++)
+    FWRITE(obs->rad[id], double, obs->nr, out);
+  for(id=0; id<ctl->nd; id++)
+    FWRITE(obs->tau[id], double, obs->nr, out);
+}
+
@@ -36,6 +36,22 @@ int locate(double *xx,  /* array */
 	   int n,       /* array size */ 
 	   double x);   /* value */
 
+/* Find array index on regular grid. */
+int locate_reg(double *xx,  /* array */
+	       int n,       /* array size */
+	       double x);   /* value */
+
+/* Find array index, starting from a previous result. */
+int locate_hint(double *xx,  /* array */
+		int n,       /* array size */
+		double x,    /* value */
+		int ilo);    /* previous index (<0 for none) */
+
+/* Read double values from string (same results as sscanf with "%lg"). */
+int scan_doubles(const char *s,  /* string */
+		 double *x,       /* values */
+		 int n);         /* number of values */
+
 /* Read observation data. */
 /* Reads observations e.g for retrieval */
 void read_obs(const char *dirname,
@@ -43,10 +59,20 @@ void read_obs(const char *dirname,
 	      ctl_t *ctl,
 	      obs_t *obs);
 
+/* Read observation data (binary format). */
+void read_obs_bin(FILE *in,
+		  ctl_t *ctl,
+		  obs_t *obs);
+
 /* Write observation data. */
 void write_obs(const char *dirname,
 	       const char *filename,
 	       ctl_t *ctl,
 	       obs_t *obs);
 
+/* Write observation data (binary format). */
+void write_obs_bin(FILE *out,
+		   ctl_t *ctl,
+		   obs_t *obs);
+
 #endif
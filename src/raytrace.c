@@ -35,6 +35,7 @@ int main(int argc, char *argv[]) {
   
   /* Read atmospheric data... */
   read_atm(NULL, argv[3], &ctl, &atm);
+  intpol_atm_init(&ctl, &atm);
   
   /* Read aerosol and cloud data */
   if(aerofile[0]!='-' && ctl.sca_n>0) {
@@ -95,11 +96,14 @@ int main(int argc, char *argv[]) {
       for(ig=0; ig<ctl.ng; ig++)
 	fprintf(out, " %g", los.u[ip][ig]);
       for(id=0; id<ctl.nd; id++)
-	fprintf(out, " %g", aero.beta_e[los.aeroi[ip]][id]*los.aerofac[ip]);
+	fprintf(out, " %g", (los.aerofac[ip]>0 ?
+			     aero.beta_e[los.aeroi[ip]][id]*los.aerofac[ip] : 0));
       for(id=0; id<ctl.nd; id++)
-	fprintf(out, " %g", aero.beta_s[los.aeroi[ip]][id]*los.aerofac[ip]);
+	fprintf(out, " %g", (los.aerofac[ip]>0 ?
+			     aero.beta_s[los.aeroi[ip]][id]*los.aerofac[ip] : 0));
       for(id=0; id<ctl.nd; id++)
-	fprintf(out, " %g", aero.beta_a[los.aeroi[ip]][id]*los.aerofac[ip]);
+	fprintf(out, " %g", (los.aerofac[ip]>0 ?
+			     aero.beta_a[los.aeroi[ip]][id]*los.aerofac[ip] : 0));
       fprintf(out, " %g", los.ds[ip]);      
 
       fprintf(out, "\n");
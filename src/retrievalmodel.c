@@ -278,6 +278,9 @@ void kernel(ctl_t *ctl,
     copy_obs(ctl, &obs1, obs, 0);
     x2atm(ctl, x1, &atm1, &aero1);
 
+    /* Linearize particle optical properties about undisturbed state... */
+    aero1.lin=1;
+
     /* Compute radiance for disturbed atmospheric data... */
     formod(ctl, &atm1, &obs1, &aero1);
 
@@ -0,0 +1,215 @@
+#include "jurassic.h"
+#include "control.h"
+#include "atmosphere.h"
+#include "forwardmodel.h"
+#include "scatter.h"
+
+/* ------------------------------------------------------------
+   Functions...
+   ------------------------------------------------------------ */
+
+/* Integrate scattering source for given incident radiance field. */
+void quad_src(ctl_t *ctl,
+	      aero_t *aero,
+	      int il,
+	      double *lz,
+	      double *dx,
+	      double *x,
+	      double *alpha,
+	      double rad[NDMAX][NSCAALF],
+	      int ndir,
+	      double *theta2,
+	      double *phi,
+	      double *domega,
+	      double *src_sca);
+
+/* ------------------------------------------------------------
+   Main...
+   ------------------------------------------------------------ */
+
+int main(int argc, char *argv[]) {
+
+  static ctl_t ctl;
+
+  static atm_t atm;
+
+  static aero_t aero;
+
+  FILE *out;
+
+  double alpha[NSCAALF], dnorth[3], *domega, err, errmax, errmean,
+    fwd[3]={0, 0.5, 0.9}, lx[3], ly[3], lz[3], *phi, rad[NDMAX][NSCAALF],
+    src_ref[NDMAX], src_sca[NDMAX], *theta2, x[3], z;
+
+  int id, idir, ifwd, il, iphi, itheta, n, ndir,
+    nref=720, ndirs[11]={0, 25, 50, 100, 200, 400, 800, 1600, 3200, 6400,
+			 12800};
+
+  /* Check arguments... */
+  if(argc<5)
+    ERRMSG("Give parameters: <ctl> <atm> <aero> <outfile>");
+
+  /* Read control parameters... */
+  read_ctl(argc, argv, &ctl);
+  if(ctl.ip!=1 || ctl.sca_n<=0)
+    ERRMSG("Set IP=1 and SCA_N>0 for quadrature report!");
+
+  /* Read atmospheric data... */
+  read_atm(NULL, argv[2], &ctl, &atm);
+  hydrostatic(&ctl, &atm);
+  intpol_atm_init(&ctl, &atm);
+
+  /* Read aerosol and cloud data... */
+  read_aero(NULL, argv[3], &ctl, &aero);
+  get_opt_prop(&ctl, &aero);
+
+  /* Allocate... */
+  ALLOC(theta2, double, 2*nref*nref);
+  ALLOC(phi, double, 2*nref*nref);
+  ALLOC(domega, double, 2*nref*nref);
+
+  /* Create file... */
+  printf("Write quadrature report: %s\n", argv[4]);
+  if(!(out=fopen(argv[4], "w")))
+    ERRMSG("Cannot create file!");
+
+  /* Write header... */
+  fprintf(out,
+	  "# $1 = aerosol/cloud layer index\n"
+	  "# $2 = altitude [km]\n"
+	  "# $3 = number of directions (0=regular 180x180 grid)\n"
+	  "# $4 = fraction of directions for phase function weighting\n"
+	  "# $5 = maximum relative error of scattering source [%%]\n"
+	  "# $6 = mean relative error of scattering source [%%]\n");
+
+  /* Loop over layers... */
+  for(il=0; il<aero.nl; il++) {
+
+    /* Set limb LOS inside layer (off center to avoid vertical beams
+       starting on atmospheric levels)... */
+    z=aero.bottom[il]+0.4*(aero.top[il]-aero.bottom[il]);
+    geo2cart(z, 0, 0, x);
+    dnorth[0]=-x[0];
+    dnorth[1]=-x[1];
+    dnorth[2]=2*RE-x[2];
+    bascoord(x, dnorth, lx, ly, lz);
+
+    /* Get incident radiance field (single scattering)... */
+    srcfunc_sca_1d_ang(alpha);
+    srcfunc_sca_1d_inc(&ctl, &atm, &aero, x, alpha, 1, rad);
+
+    /* Get reference with fine regular grid... */
+    n=0;
+    for(itheta=0; itheta<nref; itheta++)
+      for(iphi=0; iphi<2*nref; iphi++) {
+	theta2[n]=(0.5+itheta)/nref*M_PI;
+	phi[n]=(0.5+iphi)/(2*nref)*2*M_PI;
+	domega[n]=M_PI/nref*M_PI/nref*sin(theta2[n]);
+	n++;
+      }
+    quad_src(&ctl, &aero, il, lz, ly, x, alpha, rad, n,
+	     theta2, phi, domega, src_ref);
+
+    /* Loop over quadratures... */
+    fprintf(out, "\n");
+    for(idir=0; idir<11; idir++)
+      for(ifwd=0; ifwd<(ndirs[idir]>0 ? 3 : 1); ifwd++) {
+
+	/* Get directions... */
+	ctl.sca_ndir=ndirs[idir];
+	ctl.sca_fwd=fwd[ifwd];
+	srcfunc_sca_3d_quad(&ctl, &aero, il, &ndir, theta2, phi, domega);
+
+	/* Integrate... */
+	quad_src(&ctl, &aero, il, lz, ly, x, alpha, rad, ndir,
+		 theta2, phi, domega, src_sca);
+
+	/* Get errors... */
+	errmax=errmean=0;
+	for(id=0; id<ctl.nd; id++) {
+	  err=100*fabs(src_sca[id]/src_ref[id]-1);
+	  errmax=GSL_MAX(errmax, err);
+	  errmean+=err/ctl.nd;
+	}
+
+	/* Write output... */
+	fprintf(out, "%d %g %d %g %g %g\n", il,
+		z, ctl.sca_ndir, ctl.sca_fwd,
+		errmax, errmean);
+      }
+  }
+
+  /* Close file... */
+  fclose(out);
+
+  /* Free... */
+  free(theta2);
+  free(phi);
+  free(domega);
+
+  return EXIT_SUCCESS;
+}
+
+/*****************************************************************************/
+
+void quad_src(ctl_t *ctl,
+	      aero_t *aero,
+	      int il,
+	      double *lz,
+	      double *dx,
+	      double *x,
+	      double *alpha,
+	      double rad[NDMAX][NSCAALF],
+	      int ndir,
+	      double *theta2,
+	      double *phi,
+	      double *domega,
+	      double *src_sca) {
+
+  double alpha2, ek[3], phase2, rad2, sx[3], sy[3], sz[3], theta[NTHETA],
+    w, wsum[NDMAX];
+
+  int i, id, idir, idp, idx, itheta;
+
+  /* Set scattering phase function angles... */
+  for(itheta=0; itheta<NTHETA; itheta++)
+    theta[itheta]=M_PI*(double)itheta/(NTHETA-1);
+
+  /* Get orthonormal basis (with respect to LOS)... */
+  bascoord(dx, x, sx, sy, sz);
+
+  /* Initialize... */
+  for(id=0; id<ctl->nd; id++) {
+    src_sca[id]=0;
+    wsum[id]=0;
+  }
+
+  /* Loop over directions... */
+  for(idir=0; idir<ndir; idir++) {
+
+    /* Get unit vector and zenith angle of incident radiation... */
+    for(i=0; i<3; i++)
+      ek[i]
+	=sin(theta2[idir])*sin(phi[idir])*sx[i]
+	+sin(theta2[idir])*cos(phi[idir])*sy[i]
+	+cos(theta2[idir])*sz[i];
+    alpha2=acos(GSL_MIN(GSL_MAX(-DOTP(lz, ek), -1), 1));
+    idx=locate(alpha, NSCAALF, alpha2);
+    idp=locate(theta, NTHETA, theta2[idir]);
+
+    /* Loop over channels... */
+    for(id=0; id<ctl->nd; id++) {
+      phase2=LIN(theta[idp], aero->p[il][id][idp],
+		 theta[idp+1], aero->p[il][id][idp+1], theta2[idir]);
+      rad2=LIN(alpha[idx], rad[id][idx],
+	       alpha[idx+1], rad[id][idx+1], alpha2);
+      w=domega[idir]*phase2;
+      src_sca[id]+=w*rad2;
+      wsum[id]+=w;
+    }
+  }
+
+  /* Normalize... */
+  for(id=0; id<ctl->nd; id++)
+    src_sca[id]/=wsum[id];
+}
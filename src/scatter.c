@@ -59,177 +59,208 @@ void bhmie(double x,
 	   double *qext,
 	   double *qsca) {
   
-  gsl_complex cxan, cxbn, cxxi, cxy, cxxi1, cxtemp, cxref, 
-    cxs1[NTHETA+2], cxs2[NTHETA+2], cxd[10000];
+  bhmie_batch(1, &x, n_real, n_imag, phase, qext, qsca);
+}
+
+/*****************************************************************************/
+
+void bhmie_batch(int nx,
+		 double *x,
+		 double n_real,
+		 double n_imag,
+		 double *phase,
+		 double *qext,
+		 double *qsca) {
   
-  double apsi, apsi1, chi, chi0, chi1, dang, fn, p, rn, t, theta2,
-    xstop, ymod, dn, dx, psi, psi0, psi1, amu[NTHETA+2], pi[NTHETA+2],
-    pi0[NTHETA+2], pi1[NTHETA+2], tau[NTHETA+2];
+  double *di, *dr, amu[NTHETA], b1i[NTHETA], b1r[NTHETA], b2i[NTHETA],
+    b2r[NTHETA], pi0[NTHETA], pi1[NTHETA], s1i[NTHETA], s1r[NTHETA],
+    s2i[NTHETA], s2r[NTHETA], ani, anr, bni, bnr, chi, chi0, chi1, d2, dang,
+    deni, denr, fa, fb, fn, ga, gb, m2, numi, numr, pf, pi, psi, psi0, psi1,
+    rn, ryi, ryr, tau, ti, tr, ui, ur, xstop, y2, yi, yr;
   
-  int i, j, jj, n, nmx, nn, nstop, ntheta;
+  int i, ix, j, n, nmax=0, nmx, nstop, ntheta;
   
   /* Set scattering angles, ntheta=(NTHETA+1)/2... */
   if((NTHETA+1)%2!=0)
     ERRMSG("NTHETA needs to be odd!");
   ntheta=(NTHETA+1)/2;
-  
-  /* Bohren-Huffman Mie code... */
-  cxref=gsl_complex_rect(n_real, n_imag);
-  dx=x;
-  cxy=gsl_complex_mul(gsl_complex_rect(x, 0.0), cxref);
-  
-  /* Series expansion terminated after NSTOP terms */  
-  xstop=x+4.E0*pow(x,0.3333)+2.0;
-  nstop=(int)xstop;
-  ymod = gsl_complex_abs(cxy);
-  nmx=(int)((xstop>ymod ? xstop : ymod)+15);
-  if(nmx>10000)
-    ERRMSG("Too many Mie terms!");
   dang=.5E0*M_PI/(double)(ntheta-1);
-  for(j=1; j<=ntheta; j++) {
-    theta2=(double)(j-1)*dang;
-    amu[j]=cos(theta2);
-  }
-
-  /* Logarithmic derivative D(J) calculated by downward recurrence */
-  /*  beginning with initial value (0.,0.) at J=NMX */ 
-  cxd[nmx] = gsl_complex_rect(0.E0, 0.E0);
-  nn=nmx-1;
-  for(n=1; n<= nn; n++) {
-    rn=nmx-n+1;
-    cxtemp=gsl_complex_add(cxd[nmx-n+1],
-			   gsl_complex_div(gsl_complex_rect(rn, 0.0), cxy));
-    cxtemp=gsl_complex_div(gsl_complex_rect(1.0, 0.0), cxtemp);
-    cxd[nmx-n]
-      =gsl_complex_sub(gsl_complex_div(gsl_complex_rect(rn, 0.0), cxy), cxtemp);
+  for(j=0; j<ntheta; j++)
+    amu[j]=cos((double)j*dang);
+  
+  /* Get size of work space... */
+  m2=n_real*n_real+n_imag*n_imag;
+  for(ix=0; ix<nx; ix++) {
+    xstop=x[ix]+4.E0*pow(x[ix],0.3333)+2.0;
+    nmx=(int)(GSL_MAX(xstop, x[ix]*sqrt(m2))+15);
+    nmax=GSL_MAX_INT(nmax, nmx);
   }
+  ALLOC(dr, double, nmax+1);
+  ALLOC(di, double, nmax+1);
   
-  for(j=1; j<=ntheta; j++) {
-    pi0[j]=0.E0;
-    pi1[j]=1.E0;
-  }
-  
-  nn=2*ntheta-1;
-  for(j=1; j<=nn; j++) {
-    cxs1[j] = gsl_complex_rect(0.E0, 0.E0);
-    cxs2[j] = gsl_complex_rect(0.E0, 0.E0);
-  }
-
-  /* Riccati-Bessel functions with real argument X */
-  /*  calculated by upward recurrence */
-  psi0=cos(dx);
-  psi1=sin(dx);
-  chi0=-sin(x);
-  chi1=cos(x);
-  apsi1=psi1;
-  cxxi1 = gsl_complex_rect(apsi1,-chi1);
-  *qsca=0.E0;
-
-  for(n=1; n<=nstop; n++) {  
-    dn=n;
-    rn=n;
-    fn=(2.E0*rn+1.E0)/(rn*(rn+1.E0));
-    psi=(2.E0*dn-1.E0)*psi1/dx-psi0;
-    apsi=psi;
-    chi=(2.E0*rn-1.E0)*chi1/x-chi0;
-    cxxi=gsl_complex_rect(apsi,-chi);
-
-    cxan=gsl_complex_div(cxd[n], cxref);
-    cxan=gsl_complex_add(cxan, gsl_complex_rect(rn/x, 0.0));
-    cxan=gsl_complex_mul(cxan, gsl_complex_rect(apsi, 0.0));
-    cxan=gsl_complex_sub(cxan, gsl_complex_rect(apsi1, 0.0));
-
-    cxtemp=gsl_complex_div(cxd[n], cxref);
-    cxtemp=gsl_complex_add(cxtemp, gsl_complex_rect(rn/x, 0.0));
-    cxtemp=gsl_complex_mul(cxtemp, cxxi);
-    cxtemp=gsl_complex_sub(cxtemp, cxxi1);
-    cxan=gsl_complex_div(cxan, cxtemp);
-
-    cxbn=gsl_complex_mul(cxref, cxd[n]);
-    cxbn=gsl_complex_add(cxbn, gsl_complex_rect(rn/x, 0.0));
-    cxbn=gsl_complex_mul(cxbn, gsl_complex_rect(apsi, 0.0));
-    cxbn=gsl_complex_sub(cxbn, gsl_complex_rect(apsi1, 0.0));
-
-    cxtemp=gsl_complex_mul(cxref, cxd[n]);
-    cxtemp=gsl_complex_add(cxtemp, gsl_complex_rect(rn/x, 0.0));
-    cxtemp=gsl_complex_mul(cxtemp, cxxi);
-    cxtemp=gsl_complex_sub(cxtemp, cxxi1);
-    cxbn=gsl_complex_div(cxbn, cxtemp);
- 
-    *qsca=*qsca+(2.*rn+1.)
-      *(gsl_complex_abs(cxan)*gsl_complex_abs(cxan)
-	+gsl_complex_abs(cxbn)*gsl_complex_abs(cxbn));
-    for(j=1; j<=ntheta; j++) {
-      jj=2*ntheta-j;
-      pi[j]=pi1[j];
-      tau[j]=rn*amu[j]*pi[j]-(rn+1.E0)*pi0[j];
-      p=pow(-1.0,n-1);
+  /* Loop over size parameters... */
+  for(ix=0; ix<nx; ix++) {
+    
+    /* Bohren-Huffman Mie code... */
+    yr=x[ix]*n_real;
+    yi=x[ix]*n_imag;
+    y2=yr*yr+yi*yi;
+    ryr=yr/y2;
+    ryi=-yi/y2;
+    
+    /* Series expansion terminated after NSTOP terms */  
+    xstop=x[ix]+4.E0*pow(x[ix],0.3333)+2.0;
+    nstop=(int)xstop;
+    nmx=(int)(GSL_MAX(xstop, sqrt(y2))+15);
+    
+    /* Logarithmic derivative D(J) calculated by downward recurrence */
+    /*  beginning with initial value (0.,0.) at J=NMX */ 
+    dr[nmx]=di[nmx]=0.E0;
+    for(n=nmx; n>1; n--) {
+      tr=dr[n]+n*ryr;
+      ti=di[n]+n*ryi;
+      d2=tr*tr+ti*ti;
+      dr[n-1]=n*ryr-tr/d2;
+      di[n-1]=n*ryi+ti/d2;
+    }
+    
+    /* Initialize angular functions and amplitudes... */
+    for(j=0; j<ntheta; j++) {
+      pi0[j]=0.E0;
+      pi1[j]=1.E0;
+      s1r[j]=s1i[j]=s2r[j]=s2i[j]=0.E0;
+      b1r[j]=b1i[j]=b2r[j]=b2i[j]=0.E0;
+    }
+    
+    /* Riccati-Bessel functions with real argument X */
+    /*  calculated by upward recurrence */
+    psi0=cos(x[ix]);
+    psi1=sin(x[ix]);
+    chi0=-sin(x[ix]);
+    chi1=cos(x[ix]);
+    qsca[ix]=0.E0;
+    
+    for(n=1; n<=nstop; n++) {  
+      rn=n;
+      fn=(2.E0*rn+1.E0)/(rn*(rn+1.E0));
+      psi=(2.E0*rn-1.E0)*psi1/x[ix]-psi0;
+      chi=(2.E0*rn-1.E0)*chi1/x[ix]-chi0;
       
-      cxtemp=gsl_complex_mul(cxan, gsl_complex_rect(pi[j], 0.0));
-      cxtemp
-	=gsl_complex_add(cxtemp, gsl_complex_mul(cxbn, gsl_complex_rect(tau[j],
-									0.0)));
-      cxtemp=gsl_complex_mul(gsl_complex_rect(fn, 0.0), cxtemp);
-      cxs1[j]=gsl_complex_add(cxs1[j], cxtemp);
+      /* Coefficient a_n from D/m+n/x... */
+      ur=(dr[n]*n_real+di[n]*n_imag)/m2+rn/x[ix];
+      ui=(di[n]*n_real-dr[n]*n_imag)/m2;
+      numr=psi*ur-psi1;
+      numi=psi*ui;
+      denr=psi*ur+chi*ui-psi1;
+      deni=psi*ui-chi*ur+chi1;
+      d2=denr*denr+deni*deni;
+      anr=(numr*denr+numi*deni)/d2;
+      ani=(numi*denr-numr*deni)/d2;
       
-      t=pow(-1.0,n);
+      /* Coefficient b_n from m*D+n/x... */
+      ur=n_real*dr[n]-n_imag*di[n]+rn/x[ix];
+      ui=n_real*di[n]+n_imag*dr[n];
+      numr=psi*ur-psi1;
+      numi=psi*ui;
+      denr=psi*ur+chi*ui-psi1;
+      deni=psi*ui-chi*ur+chi1;
+      d2=denr*denr+deni*deni;
+      bnr=(numr*denr+numi*deni)/d2;
+      bni=(numi*denr-numr*deni)/d2;
       
-      cxtemp=gsl_complex_mul(cxan, gsl_complex_rect(tau[j], 0.0));
-      cxtemp
-	=gsl_complex_add(cxtemp, gsl_complex_mul(cxbn, gsl_complex_rect(pi[j],
-									0.0)));
-      cxtemp=gsl_complex_mul(gsl_complex_rect(fn, 0.0), cxtemp);
-      cxs2[j]=gsl_complex_add(cxs2[j], cxtemp);
+      qsca[ix]+=(2.*rn+1.)*(anr*anr+ani*ani+bnr*bnr+bni*bni);
       
-      if(j!=jj) {
-	cxtemp=gsl_complex_mul(cxan, gsl_complex_rect(pi[j]*p, 0.0));
-	cxtemp
-	  =gsl_complex_add(cxtemp,
-			   gsl_complex_mul(cxbn,
-					   gsl_complex_rect(tau[j]*t, 0.0)));
-	cxtemp=gsl_complex_mul(gsl_complex_rect(fn, 0.0), cxtemp);
-	cxs1[jj]=gsl_complex_add(cxs1[jj], cxtemp);
-	cxtemp=gsl_complex_mul(cxan, gsl_complex_rect(tau[j]*t, 0.0));
-	cxtemp
-	  =gsl_complex_add(cxtemp,
-			   gsl_complex_mul(cxbn,
-					   gsl_complex_rect(pi[j]*p, 0.0)));
-	cxtemp=gsl_complex_mul(gsl_complex_rect(fn, 0.0), cxtemp);
-	cxs2[jj]=gsl_complex_add(cxs2[jj], cxtemp);
+      /* Update amplitudes for forward (S) and backward (B) hemisphere, */
+      /* the backward terms carry a factor (-1)^(n-1)... */
+      pf=(n%2 ? fn : -fn);
+      for(j=0; j<ntheta; j++) {
+	pi=pi1[j];
+	tau=rn*amu[j]*pi-(rn+1.E0)*pi0[j];
+	fa=fn*pi;
+	fb=fn*tau;
+	s1r[j]+=anr*fa+bnr*fb;
+	s1i[j]+=ani*fa+bni*fb;
+	s2r[j]+=anr*fb+bnr*fa;
+	s2i[j]+=ani*fb+bni*fa;
+	ga=pf*pi;
+	gb=pf*tau;
+	b1r[j]+=anr*ga-bnr*gb;
+	b1i[j]+=ani*ga-bni*gb;
+	b2r[j]+=bnr*ga-anr*gb;
+	b2i[j]+=bni*ga-ani*gb;
+	
+	/* Compute pi_n+1 from pi_n and pi_n-1... */
+	pi1[j]=((2.*rn+1.)*amu[j]*pi-(rn+1.)*pi0[j])/rn;
+	pi0[j]=pi;
       }
+      
+      psi0=psi1;
+      psi1=psi;
+      chi0=chi1;
+      chi1=chi;
     }
     
-    psi0=psi1;
-    psi1=psi;
-    apsi1=psi1;
-    chi0=chi1;
-    chi1=chi;
-    cxxi1=gsl_complex_rect(apsi1, -chi1);
+    /* Compute efficiencies... */
+    qsca[ix]=(2.E0/(x[ix]*x[ix]))*qsca[ix];
+    qext[ix]=(4.E0/(x[ix]*x[ix]))*s1r[0];
     
-    /* For each angle J, compute pi_n+1 from PI = pi_n , PI0 = pi_n-1 */
-    for(j=1; j<=ntheta; j++) {
-      pi1[j]=((2.*rn+1.)*amu[j]*pi[j]-(rn+1.)*pi0[j])/rn;
-      pi0[j]=pi[j];
+    /* Compute phase function from scattering amplitudes... */
+    /* calculate phase function following Liou: p192 eq 5.2.111a */
+    /* P_11 = 4*PI*(i_1+i_2)/(2*k^2*sigma_s)) */
+    /* i_1(theta), i_2(theta) = abs(S_1(theta))^2, abs(S_2(theta))^2 */
+    /* intensity functions for perpendicular and parallel components */
+    /* Q_s = sigma_s/(PI *rad^2) - scattering efficiency (here qsca) */
+    /* sigma_s = scattering cross section */
+    /* x = k*rad - size parameter (x=2*PI*rad/lambda) */
+    for(i=0; i<ntheta; i++)
+      phase[ix*NTHETA+i]=2/(x[ix]*x[ix]*qsca[ix])
+	*(s1r[i]*s1r[i]+s1i[i]*s1i[i]+s2r[i]*s2r[i]+s2i[i]*s2i[i]);
+    for(i=ntheta; i<2*ntheta-1; i++) {
+      j=2*ntheta-2-i;
+      phase[ix*NTHETA+i]=2/(x[ix]*x[ix]*qsca[ix])
+	*(b1r[j]*b1r[j]+b1i[j]*b1i[j]+b2r[j]*b2r[j]+b2i[j]*b2i[j]);
     }
   }
   
-  /* Compute efficiencies... */
-  *qsca=(2.E0/(x*x))*(*qsca);
-  *qext=(4.E0/(x*x))*cxs1[1].dat[0];
-  
-  /* Compute phase function from scattering amplitudes... */
-  /* calculate phase function following Liou: p192 eq 5.2.111a */
-  /* P_11 = 4*PI*(i_1+i_2)/(2*k^2*sigma_s)) */
-  /* i_1(theta), i_2(theta) = abs(S_1(theta))^2, abs(S_2(theta))^2 */
-  /* intensity functions for perpendicular and parallel components */
-  /* Q_s = sigma_s/(PI *rad^2) - scattering efficiency (here qsca) */
-  /* sigma_s = scattering cross section */
-  /* x = k*rad - size parameter (x=2*PI*rad/lambda) */
-
-  for(i=0; i<2*ntheta-1; i++)
-    phase[i]=2/(x*x*(*qsca))
-      *(cxs1[i+1].dat[0]*cxs1[i+1].dat[0]+cxs1[i+1].dat[1]*cxs1[i+1].dat[1]
-	+cxs2[i+1].dat[0]*cxs2[i+1].dat[0]+cxs2[i+1].dat[1]*cxs2[i+1].dat[1]);
+  /* Free... */
+  free(dr);
+  free(di);
+}
+
+/*****************************************************************************/
+
+void bhmie_tab(ctl_t *ctl,
+	       const char *refrac,
+	       double nu,
+	       double n_real,
+	       double n_imag,
+	       double xmin,
+	       double xmax,
+	       int nx,
+	       double *x,
+	       double *phase,
+	       double *qext,
+	       double *qsca) {
+  
+  mietab_t *tab;
+  
+  double u, w;
+  
+  int i, ia, ix;
+  
+  /* Get lookup table... */
+  tab=get_mie_tab(ctl, refrac, nu, n_real, n_imag, xmin, xmax);
+  
+  /* Interpolate in logarithm of size parameter... */
+  for(ix=0; ix<nx; ix++) {
+    u=(log(x[ix])-tab->lx0)/tab->dlx;
+    i=GSL_MIN_INT(GSL_MAX_INT((int)u, 0), MIENX-2);
+    w=GSL_MIN(GSL_MAX(u-i, 0), 1);
+    qext[ix]=(1-w)*tab->qext[i]+w*tab->qext[i+1];
+    qsca[ix]=(1-w)*tab->qsca[i]+w*tab->qsca[i+1];
+    for(ia=0; ia<NTHETA; ia++)
+      phase[ix*NTHETA+ia]=(1-w)*tab->phase[i][ia]+w*tab->phase[i+1][ia];
+  }
 }
 
 /*****************************************************************************/
@@ -326,12 +357,190 @@ void gauher(double *x,
 }
 
 /*****************************************************************************/
+
+void free_sca_queue(scaq_t *q) {
+  
+  int il, ir;
+  
+  /* Free scattering points... */
+  for(ir=0; ir<NRMAX; ir++)
+    if(q->npmax[ir]>0) {
+      free(q->x[ir]);
+      free(q->dx[ir]);
+      free(q->il[ir]);
+      free(q->ib[ir]);
+      free(q->w[ir]);
+    }
+  
+  /* Free directions of incident radiation... */
+  for(il=0; il<NLMAX; il++)
+    if(q->ndir[il]>0) {
+      free(q->theta2[il]);
+      free(q->phi[il]);
+      free(q->domega[il]);
+    }
+  
+  /* Free secondary rays... */
+  if(q->nb>0) {
+    free(q->xo);
+    free(q->xv);
+    free(q->ir);
+    free(q->ip);
+    free(q->ord);
+    free(q->rad);
+  }
+  
+  /* Free queue... */
+  free(q);
+}
+
+/*****************************************************************************/
+
+mietab_t *get_mie_tab(ctl_t *ctl,
+		      const char *refrac,
+		      double nu,
+		      double n_real,
+		      double n_imag,
+		      double xmin,
+		      double xmax) {
+  
+  static mietab_t *tabs[MIETABMAX];
+  
+  static int ntab=0, next=0;
+  
+  FILE *in, *out;
+  
+  mietab_t *tab;
+  
+  const char *name;
+  
+  char file[2*LEN], magic[4];
+  
+  double head[5], x[MIENX];
+  
+  double dlx, lx0;
+  
+  int i, n[2], ok=0;
+  
+  /* Get grid of size parameters... */
+  lx0=log(xmin);
+  dlx=(log(xmax)-lx0)/(MIENX-1);
+  
+  /* Check tables in memory... */
+  for(i=0; i<ntab; i++)
+    if(tabs[i]->nu==nu && tabs[i]->n_real==n_real
+       && tabs[i]->n_imag==n_imag && tabs[i]->lx0==lx0 && tabs[i]->dlx==dlx
+       && strcmp(tabs[i]->refrac, refrac)==0)
+      return tabs[i];
+  
+  /* Get memory (replace oldest table if cache is full)... */
+  if(ntab<MIETABMAX) {
+    ALLOC(tabs[ntab], mietab_t, 1);
+    tab=tabs[ntab++];
+  } else {
+    tab=tabs[next];
+    next=(next+1)%MIETABMAX;
+  }
+  
+  /* Set table parameters... */
+  strcpy(tab->refrac, refrac);
+  tab->nu=nu;
+  tab->n_real=n_real;
+  tab->n_imag=n_imag;
+  tab->lx0=lx0;
+  tab->dlx=dlx;
+  
+  /* Set filename... */
+  name=strrchr(refrac, '/');
+  sprintf(file, "%s_%s_%.4f.tab", ctl->sca_mietab,
+	  name!=NULL ? name+1 : refrac, nu);
+  
+  /* Try to read table... */
+  if((in=fopen(file, "r"))) {
+    FREAD(magic, char, 4, in);
+    FREAD(n, int, 2, in);
+    FREAD(head, double, 5, in);
+    if(memcmp(magic, "JMIE", 4)==0 && n[0]==MIENX && n[1]==NTHETA
+       && head[0]==tab->nu && head[1]==tab->n_real && head[2]==tab->n_imag
+       && head[3]==tab->lx0 && head[4]==tab->dlx) {
+      printf("Read Mie lookup table: %s\n", file);
+      FREAD(tab->qext, double, MIENX, in);
+      FREAD(tab->qsca, double, MIENX, in);
+      FREAD(tab->phase, double, MIENX*NTHETA, in);
+      ok=1;
+    }
+    fclose(in);
+  }
+  
+  /* Compute and write table... */
+  if(!ok) {
+    for(i=0; i<MIENX; i++)
+      x[i]=exp(tab->lx0+i*tab->dlx);
+    bhmie_batch(MIENX, x, n_real, n_imag, tab->phase[0], tab->qext,
+		tab->qsca);
+    printf("Write Mie lookup table: %s\n", file);
+    if(!(out=fopen(file, "w")))
+      ERRMSG("Cannot create file!");
+    n[0]=MIENX;
+    n[1]=NTHETA;
+    head[0]=tab->nu;
+    head[1]=tab->n_real;
+    head[2]=tab->n_imag;
+    head[3]=tab->lx0;
+    head[4]=tab->dlx;
+    FWRITE("JMIE", char, 4, out);
+    FWRITE(n, int, 2, out);
+    FWRITE(head, double, 5, out);
+    FWRITE(tab->qext, double, MIENX, out);
+    FWRITE(tab->qsca, double, MIENX, out);
+    FWRITE(tab->phase, double, MIENX*NTHETA, out);
+    fclose(out);
+  }
+  
+  return tab;
+}
+
+/*****************************************************************************/
+
 void get_opt_prop(ctl_t *ctl,
 		  aero_t *aero){
 
+  static char type[SCAMOD][LEN], filepath[SCAMOD][LEN];
+
+  static double (*mbeta_e)[NDMAX], (*mbeta_s)[NDMAX], (*mp)[NDMAX][NTHETA],
+    (*dbeta_e)[3][NDMAX], (*dbeta_s)[3][NDMAX], (*dp)[3][NDMAX][NTHETA],
+    lbeta_e[NDMAX], lbeta_s[NDMAX], (*lp)[NTHETA],
+    nn[SCAMOD], nu[NDMAX], rr[SCAMOD], ss[SCAMOD];
+
+  static int nd=-1, dvalid[SCAMOD], valid[SCAMOD];
+
+  double *be, *bs, (*pp)[NTHETA], dx[3];
+
   int nl=1, nm=1, count=0;
-  int ii,jj, id, itheta;  
-  double mbeta_e[NDMAX], mbeta_s[NDMAX], mp[NDMAX][NTHETA];
+  int ii,jj, id, ip, itheta, chg, lin;  
+
+  /* Allocate cache of optical properties per mode... */
+  if(nd<0) {
+    ALLOC(mbeta_e, double[NDMAX], SCAMOD);
+    ALLOC(mbeta_s, double[NDMAX], SCAMOD);
+    ALLOC(mp, double[NDMAX][NTHETA], SCAMOD);
+  }
+
+  /* Allocate cache of derivatives... */
+  if(ctl->sca_jac && dbeta_e==NULL) {
+    ALLOC(dbeta_e, double[3][NDMAX], SCAMOD);
+    ALLOC(dbeta_s, double[3][NDMAX], SCAMOD);
+    ALLOC(dp, double[3][NDMAX][NTHETA], SCAMOD);
+    ALLOC(lp, double[NTHETA], NDMAX);
+  }
+
+  /* Invalidate cache if spectral grid has changed... */
+  if(nd!=ctl->nd || memcmp(nu, ctl->nu, (size_t)ctl->nd*sizeof(double))!=0) {
+    nd=ctl->nd;
+    memcpy(nu, ctl->nu, (size_t)nd*sizeof(double));
+    for(ii=0; ii<SCAMOD; ii++)
+      valid[ii]=dvalid[ii]=0;
+  }
  
   /* check input data */
   /* ToDo: improve check and sort data */
@@ -372,44 +581,104 @@ void get_opt_prop(ctl_t *ctl,
       aero->beta_e[ii][id] = 0.;
       aero->beta_a[ii][id] = 0.;
       aero->beta_s[ii][id] = 0.;
-      for(itheta=0; itheta<NTHETA; itheta++){
+      for(itheta=0; itheta<NTHETA; itheta++)
 	aero->p[ii][id][itheta] = 0.;
-	mp[id][itheta] = 0.;
-      }
-      mbeta_e[id] = 0.;
-      mbeta_s[id] = 0.;
     }
 
     /* Get optical properties for each mode. */
     for (jj=0; jj<aero->nmod[ii]; jj++){
 
-      if(strcasecmp(aero->type[count], "MIE")==0){
-    	/* Get optical properties for log-normal mode using Mie theory. */ 
-	/* Gauss-Hermite integration */
-	opt_prop_mie_log(ctl, aero, count, mbeta_e, mbeta_s, mp);
-      } 
-      else if(strcasecmp(aero->type[count], "Ext")==0){ 
-	/* Get optical properties from external data base. Selects properties from closest wavenumber in data base file. */
-	opt_prop_external(ctl, aero, count, mbeta_e, mbeta_s, mp);
-      } else if(strcasecmp(aero->type[count], "Const")==0){ 
-    	printf("Using constant extinction [1/km]: %g\n", aero->nn[count]);
-    	ERRMSG("Implement me!");
+      /* Check whether mode parameters have changed... */
+      chg=(!valid[count] || aero->nn[count]!=nn[count]
+	   || aero->rr[count]!=rr[count] || aero->ss[count]!=ss[count]
+	   || strcmp(aero->type[count], type[count])!=0
+	   || strcmp(aero->filepath[count], filepath[count])!=0);
+
+      /* Linearize about cached mode for perturbed particle parameters... */
+      lin=(chg && aero->lin && ctl->sca_jac && valid[count] && dvalid[count]
+	   && strcmp(aero->type[count], type[count])==0
+	   && strcmp(aero->filepath[count], filepath[count])==0);
+      be=mbeta_e[count];
+      bs=mbeta_s[count];
+      pp=mp[count];
+      if(lin){
+	dx[0]=aero->nn[count]-nn[count];
+	dx[1]=aero->rr[count]-rr[count];
+	dx[2]=aero->ss[count]-ss[count];
+	for(id=0; id<ctl->nd; id++){
+	  lbeta_e[id]=mbeta_e[count][id];
+	  lbeta_s[id]=mbeta_s[count][id];
+	  for(itheta=0; itheta<NTHETA; itheta++)
+	    lp[id][itheta]=mp[count][id][itheta];
+	  for(ip=0; ip<3; ip++){
+	    lbeta_e[id]+=dbeta_e[count][ip][id]*dx[ip];
+	    lbeta_s[id]+=dbeta_s[count][ip][id]*dx[ip];
+	    for(itheta=0; itheta<NTHETA; itheta++)
+	      lp[id][itheta]+=dp[count][ip][id][itheta]*dx[ip];
+	  }
+	}
+	be=lbeta_e;
+	bs=lbeta_s;
+	pp=lp;
       }
-      else {
- 	ERRMSG("Please give valid scattering model (MIE, Ext, Const)!");
+
+      /* Only recompute optical properties of changed modes. */
+      else if(chg){
+
+	/* Initialise mode */
+	valid[count]=0;
+	dvalid[count]=0;
+	for(id=0; id<ctl->nd; id++){
+	  for(itheta=0; itheta<NTHETA; itheta++)
+	    mp[count][id][itheta] = 0.;
+	  mbeta_e[count][id] = 0.;
+	  mbeta_s[count][id] = 0.;
+	  if(ctl->sca_jac)
+	    for(ip=0; ip<3; ip++){
+	      for(itheta=0; itheta<NTHETA; itheta++)
+		dp[count][ip][id][itheta] = 0.;
+	      dbeta_e[count][ip][id] = 0.;
+	      dbeta_s[count][ip][id] = 0.;
+	    }
+	}
+
+	if(strcasecmp(aero->type[count], "MIE")==0){
+	  /* Get optical properties for log-normal mode using Mie theory. */ 
+	  /* Gauss-Hermite integration */
+	  opt_prop_mie_log(ctl, aero, count, mbeta_e[count], mbeta_s[count],
+			   mp[count], ctl->sca_jac ? dbeta_e[count] : NULL,
+			   ctl->sca_jac ? dbeta_s[count] : NULL,
+			   ctl->sca_jac ? dp[count] : NULL);
+	  dvalid[count]=ctl->sca_jac;
+	} 
+	else if(strcasecmp(aero->type[count], "Ext")==0){ 
+	  /* Get optical properties from external data base. Selects properties from closest wavenumber in data base file. */
+	  opt_prop_external(ctl, aero, count, mbeta_e[count], mbeta_s[count],
+			    mp[count]);
+	} else if(strcasecmp(aero->type[count], "Const")==0){ 
+	  printf("Using constant extinction [1/km]: %g\n", aero->nn[count]);
+	  ERRMSG("Implement me!");
+	}
+	else {
+	  ERRMSG("Please give valid scattering model (MIE, Ext, Const)!");
+	}
+
+	/* Remember mode parameters */
+	valid[count]=1;
+	nn[count]=aero->nn[count];
+	rr[count]=aero->rr[count];
+	ss[count]=aero->ss[count];
+	strcpy(type[count], aero->type[count]);
+	strcpy(filepath[count], aero->filepath[count]);
       }
       
       /* Sum up optical properties for each layer */
       for(id=0; id<ctl->nd; id++){
-    	aero->beta_e[ii][id] += mbeta_e[id];
-    	aero->beta_s[ii][id] += mbeta_s[id];
-     	aero->beta_a[ii][id] += (mbeta_e[id] - mbeta_s[id]);
-    	for(itheta=0; itheta<NTHETA; itheta++){
-    	  aero->p[ii][id][itheta] += mp[id][itheta];
-	  mp[id][itheta] = 0.;
-	}
-	mbeta_e[id] = 0.;
-	mbeta_s[id] = 0.;
+    	aero->beta_e[ii][id] += be[id];
+    	aero->beta_s[ii][id] += bs[id];
+     	aero->beta_a[ii][id] += (be[id] - bs[id]);
+    	for(itheta=0; itheta<NTHETA; itheta++)
+    	  aero->p[ii][id][itheta] += pp[id][itheta];
       }
       count++;
     }
@@ -423,42 +692,57 @@ void opt_prop_mie_log(ctl_t *ctl,
 		     int count,
 		     double *beta_ext,
 		     double *beta_sca,
-		     double phase[NDMAX][NTHETA]){
+		     double phase[NDMAX][NTHETA],
+		     double dbeta_ext[3][NDMAX],
+		     double dbeta_sca[3][NDMAX],
+		     double dphase[3][NDMAX][NTHETA]){
 
   FILE *in;
   
   char line[LEN];
 
-  static int init=0;
+  static char path[LEN]="";
+
+  static int init=0, npts=0;
 
   static double nu[REFMAX], nr[REFMAX], ni[REFMAX], n_imag[NDMAX], n_real[NDMAX], 
     rad_min=0.001, rad_max=1000., weights[NRAD], zs[NRAD];
 
-  int npts=0, id, idx, nn, jj;
+  double val[3];
 
-  double K1, rad, lambda, x, qext, qsca, qphase[NTHETA];
+  int id, idx, ip, lev, nn, nrad, jj;
+
+  double (*sp)[NTHETA], (*tp)[NTHETA], K1, dp, err, h, pmax, rad,
+    rads[12*(1<<NQLEV)+1], se[NDMAX], ss[NDMAX], te[NDMAX], ts[NDMAX],
+    w[12*(1<<NQLEV)+1], dw[2*(12*(1<<NQLEV)+1)], sig, z;
 
   /* Read and interpolate refractive indices... */
-  /* Check if previous mode has the same refractive index */
-  if(count==0 || strcmp(aero->filepath[count], aero->filepath[count-1])!=0) { 
+  /* Check if previous call used the same refractive index */
+  if(strcmp(aero->filepath[count], path)!=0) { 
     
     /* Read data... */
     printf("Read refractive indices: %s\n", aero->filepath[count]);
+    npts=0;
     if(!(in=fopen(aero->filepath[count], "r")))
       ERRMSG("Cannot open file!");
     while(fgets(line, LEN, in))
-      if(sscanf(line, "%lg %lg %lg", &nu[npts], &nr[npts], &ni[npts])==3)
+      if(scan_doubles(line, val, 3)==3) {
+	nu[npts]=val[0];
+	nr[npts]=val[1];
+	ni[npts]=val[2];
 	if((++npts)>REFMAX)
 	  ERRMSG("Too many data points!");
+      }
     fclose(in);
+    strcpy(path, aero->filepath[count]);
+  }
     
-    /* Interpolate... */
-    for(id=0; id<ctl->nd; id++) {
-      idx=locate(nu, npts, ctl->nu[id]);
-      n_real[id]=LIN(nu[idx], nr[idx], nu[idx+1], nr[idx+1], ctl->nu[id]);
-      n_imag[id]=LIN(nu[idx], ni[idx], nu[idx+1], ni[idx+1], ctl->nu[id]);
-    }
-  } 
+  /* Interpolate... */
+  for(id=0; id<ctl->nd; id++) {
+    idx=locate(nu, npts, ctl->nu[id]);
+    n_real[id]=LIN(nu[idx], nr[idx], nu[idx+1], nr[idx+1], ctl->nu[id]);
+    n_imag[id]=LIN(nu[idx], ni[idx], nu[idx+1], ni[idx+1], ctl->nu[id]);
+  }
 
   /* Check log-normal parameters... */
   if(aero->nn[count]<=0 || aero->rr[count]<=0 || aero->ss[count]<=1)
@@ -473,30 +757,112 @@ void opt_prop_mie_log(ctl_t *ctl,
 
   /* set coefficient */
   K1 = aero->nn[count] * 1e-3 * sqrt(M_PI);
+  sig = log(aero->ss[count]);
 
-  /* sum up Gaussian nodes */
-  for (nn=0; nn<NRAD; ++nn) {
-    rad = exp(sqrt(2) * log(aero->ss[count]) * zs[nn] + log(aero->rr[count]));
-    if (rad >= rad_min && rad <= rad_max && K1 > 0.) {
- 
-     for(id=0; id<ctl->nd; id++){
-
-	/* size parameter */
-	lambda = 1./(ctl->nu[id])* pow(10,4.);
-	x = 2*M_PI*rad/lambda;
-
-	/* evaluate Mie Code at the nodes */
-	bhmie(x, n_real[id], n_imag[id], qphase, &qext, &qsca);
-	/* bhmie(rad, wavn, nang); */
-
-	beta_ext[id] += K1 * pow(rad,2) *  qext * weights[nn];
-	beta_sca[id] += K1 * pow(rad,2) *  qsca * weights[nn];
-	    
+  /* Integrate with fixed Gauss-Hermite quadrature... */
+  if(ctl->sca_qtol<=0) {
+    
+    /* select Gaussian nodes within the valid size range */
+    nrad=0;
+    for (nn=0; nn<NRAD; ++nn) {
+      rad = exp(sqrt(2) * log(aero->ss[count]) * zs[nn] + log(aero->rr[count]));
+      if (rad >= rad_min && rad <= rad_max && K1 > 0.) {
+	w[nrad] = weights[nn];
+	dw[2*nrad] = sqrt(2) * zs[nn] / (sig * aero->rr[count]) * w[nrad];
+	dw[2*nrad+1] = (2 * zs[nn] * zs[nn] - 1) / (sig * aero->ss[count])
+	  * w[nrad];
+	rads[nrad++] = rad;
+      }
+    }
+    
+    /* sum up Gaussian nodes */
+    opt_prop_mie_sum(ctl, aero->filepath[count], n_real, n_imag, rad_min,
+		     rad_max, K1, nrad, rads, w, dbeta_ext ? dw : NULL,
+		     beta_ext, beta_sca, phase, dbeta_ext, dbeta_sca, dphase);
+  }
+  
+  /* Integrate with nested trapezoidal rule in log-radius... */
+  else {
+    
+    /* Allocate... */
+    ALLOC(sp, double[NTHETA], NDMAX);
+    ALLOC(tp, double[NTHETA], NDMAX);
+    for(id=0; id<ctl->nd; id++){
+      se[id] = ss[id] = 0.;
+      for (jj=0; jj<NTHETA; ++jj)
+	sp[id][jj] = 0.;
+    }
+    
+    /* Halve step size until integrals converge (|z|<=6, exp(-z^2)<3e-16), */
+    /* only the new nodes need to be evaluated at each level */
+    for (lev=0, h=1.; lev<NQLEV; lev++, h/=2) {
+      
+      /* select new nodes within the valid size range */
+      nrad=0;
+      for (nn=-6*(1<<lev); nn<=6*(1<<lev); ++nn) {
+	if (lev>0 && nn%2==0)
+	  continue;
+	z = nn * h;
+	rad = exp(sqrt(2) * log(aero->ss[count]) * z + log(aero->rr[count]));
+	if (rad >= rad_min && rad <= rad_max && K1 > 0.) {
+	  w[nrad] = exp(-gsl_pow_2(z));
+	  dw[2*nrad] = sqrt(2) * z / (sig * aero->rr[count]) * w[nrad];
+	  dw[2*nrad+1] = (2 * z * z - 1) / (sig * aero->ss[count]) * w[nrad];
+	  rads[nrad++] = rad;
+	}
+      }
+      
+      /* sum up new nodes */
+      for(id=0; id<ctl->nd; id++){
+	te[id] = ts[id] = 0.;
 	for (jj=0; jj<NTHETA; ++jj)
-	  phase[id][jj] += K1 * qsca * pow(rad,2) * qphase[jj] * weights[nn];
-
-      } 
-    } 
+	  tp[id][jj] = 0.;
+      }
+      opt_prop_mie_sum(ctl, aero->filepath[count], n_real, n_imag, rad_min,
+		       rad_max, K1, nrad, rads, w, dbeta_ext ? dw : NULL,
+		       te, ts, tp, dbeta_ext, dbeta_sca, dphase);
+      
+      /* compare with estimate of previous level (h*(T+S) vs. 2h*S)... */
+      err = 0.;
+      for(id=0; id<ctl->nd; id++){
+	if (te[id]+se[id] != 0)
+	  err = GSL_MAX(err, fabs(te[id]-se[id])/fabs(te[id]+se[id]));
+	if (ts[id]+ss[id] != 0)
+	  err = GSL_MAX(err, fabs(ts[id]-ss[id])/fabs(ts[id]+ss[id]));
+	dp = pmax = 0.;
+	for (jj=0; jj<NTHETA; ++jj) {
+	  dp = GSL_MAX(dp, fabs(tp[id][jj]-sp[id][jj]));
+	  pmax = GSL_MAX(pmax, fabs(tp[id][jj]+sp[id][jj]));
+	}
+	if (pmax > 0)
+	  err = GSL_MAX(err, dp/pmax);
+	se[id] += te[id];
+	ss[id] += ts[id];
+	for (jj=0; jj<NTHETA; ++jj)
+	  sp[id][jj] += tp[id][jj];
+      }
+      if (lev>0 && err<=ctl->sca_qtol)
+	break;
+    }
+    
+    /* get integrals */
+    for(id=0; id<ctl->nd; id++){
+      beta_ext[id] += h * se[id];
+      beta_sca[id] += h * ss[id];
+      for (jj=0; jj<NTHETA; ++jj)
+	phase[id][jj] += h * sp[id][jj];
+      if (dbeta_ext != NULL)
+	for (ip=1; ip<=2; ip++) {
+	  dbeta_ext[ip][id] *= h;
+	  dbeta_sca[ip][id] *= h;
+	  for (jj=0; jj<NTHETA; ++jj)
+	    dphase[ip][id][jj] *= h;
+	}
+    }
+    
+    /* Free... */
+    free(sp);
+    free(tp);
   }
   
   /* Weight phase function with beta_s */
@@ -504,6 +870,95 @@ void opt_prop_mie_log(ctl_t *ctl,
     for (jj=0; jj<NTHETA; ++jj)
       phase[id][jj] /= beta_sca[id];
   }
+
+  /* Get derivatives of normalized phase function and with respect to */
+  /* number concentration (beta is proportional to nn)... */
+  if (dbeta_ext != NULL)
+    for(id=0; id<ctl->nd; id++){
+      for (ip=1; ip<=2; ip++)
+	for (jj=0; jj<NTHETA; ++jj)
+	  dphase[ip][id][jj] = (dphase[ip][id][jj]
+				- phase[id][jj] * dbeta_sca[ip][id])
+	    / beta_sca[id];
+      dbeta_ext[0][id] = beta_ext[id] / aero->nn[count];
+      dbeta_sca[0][id] = beta_sca[id] / aero->nn[count];
+      for (jj=0; jj<NTHETA; ++jj)
+	dphase[0][id][jj] = 0.;
+    }
+}
+
+/*****************************************************************************/
+
+void opt_prop_mie_sum(ctl_t *ctl,
+		      const char *refrac,
+		      double *n_real,
+		      double *n_imag,
+		      double rad_min,
+		      double rad_max,
+		      double K1,
+		      int nrad,
+		      double *rads,
+		      double *w,
+		      double *dw,
+		      double *beta_ext,
+		      double *beta_sca,
+		      double phase[NDMAX][NTHETA],
+		      double dbeta_ext[3][NDMAX],
+		      double dbeta_sca[3][NDMAX],
+		      double dphase[3][NDMAX][NTHETA]){
+
+  double rad, lambda, *x, *qext, *qsca, *qphase, ge, gs;
+
+  int id, ip, nn, jj;
+
+  /* Allocate... */
+  ALLOC(x, double, nrad);
+  ALLOC(qext, double, nrad);
+  ALLOC(qsca, double, nrad);
+  ALLOC(qphase, double, nrad*NTHETA);
+
+  for(id=0; id<ctl->nd; id++){
+
+    /* size parameters */
+    lambda = 1./(ctl->nu[id])* pow(10,4.);
+    for (nn=0; nn<nrad; ++nn)
+      x[nn] = 2*M_PI*rads[nn]/lambda;
+
+    /* evaluate Mie Code at the nodes (or interpolate lookup table) */
+    if(ctl->sca_mietab[0]=='-')
+      bhmie_batch(nrad, x, n_real[id], n_imag[id], qphase, qext, qsca);
+    else
+      bhmie_tab(ctl, refrac, ctl->nu[id], n_real[id], n_imag[id],
+		2*M_PI*rad_min/lambda, 2*M_PI*rad_max/lambda,
+		nrad, x, qphase, qext, qsca);
+
+    for (nn=0; nn<nrad; ++nn) {
+      rad = rads[nn];
+      beta_ext[id] += K1 * pow(rad,2) *  qext[nn] * w[nn];
+      beta_sca[id] += K1 * pow(rad,2) *  qsca[nn] * w[nn];
+	    
+      for (jj=0; jj<NTHETA; ++jj)
+	phase[id][jj] += K1 * qsca[nn] * pow(rad,2) * qphase[nn*NTHETA+jj]
+	  * w[nn];
+
+      /* derivatives with respect to median radius and width */
+      if (dw != NULL)
+	for (ip=1; ip<=2; ip++) {
+	  ge = K1 * pow(rad,2) * qext[nn] * dw[2*nn+ip-1];
+	  gs = K1 * pow(rad,2) * qsca[nn] * dw[2*nn+ip-1];
+	  dbeta_ext[ip][id] += ge;
+	  dbeta_sca[ip][id] += gs;
+	  for (jj=0; jj<NTHETA; ++jj)
+	    dphase[ip][id][jj] += gs * qphase[nn*NTHETA+jj];
+	}
+    } 
+  }
+
+  /* Free... */
+  free(x);
+  free(qext);
+  free(qsca);
+  free(qphase);
 }
 
 /*****************************************************************************/
@@ -515,66 +970,122 @@ void opt_prop_external(ctl_t *ctl,
 		       double *beta_sca,
 		       double phase[NDMAX][NTHETA]){
 
-  FILE *in;
-  
-  char line[LEN], *tok; 
+  static extdb_t db[SCAMOD];
 
-  static double nu[REFMAX], n_ext[REFMAX], n_sca[REFMAX], n_phase[REFMAX][NTHETA];
+  static int ndb=0;
 
-  int npts=0, ia, id, im;
+  extdb_t *d=NULL;
 
-  /* evtl. später Interpolation zw. Wellenlängen als Option einbauen */
+  double w;
 
-  /* Read optical properties and find closest match to each wavenumber */
-  if(aero->nn[count]==0) {
-  
-    /* Check if previous mode has the same optical properties */
-    if(count==0 || strcmp(aero->filepath[count], aero->filepath[count-1])!=0) {
-      
-      /* Check for file... */
-      printf("Read non-spherical optical properties: %s\n", aero->filepath[count]);
-      if(!(in=fopen(aero->filepath[count], "r")))
-	ERRMSG("Cannot open file!");
-      
-      /* Read data... */
-      while(fgets(line, LEN, in)) {
-    	
-	TOK(line, tok, "%lg", nu[npts]);  
-	TOK(NULL, tok, "%lg", n_ext[npts]);
-	TOK(NULL, tok, "%lg", n_sca[npts]);
-	for(ia=0; ia<NTHETA; ia++)
-	  TOK(NULL, tok, "%lg", n_phase[npts][ia]);
-	
-	if((++npts)>REFMAX)
-	  ERRMSG("Too many data points!");
-      }
-      
-      /* Close file... */
-      fclose(in);
-      
-      /* Check number of points... */
-      if(npts<1)
-	ERRMSG("Could not read any data!");
-    }
+  int i, ia, id, im;
 
-    /* Find closest match in wavenumber for each spectral point */
-    for(id=0; id<ctl->nd; id++){
-      im=locate(nu, npts, ctl->nu[id]);
-      if(im != npts && fabs(nu[im] - ctl->nu[id]) > fabs(nu[im+1] - ctl->nu[id]))
-      /* if(im != npts && (nu[im] - ctl->nu[id]) > (nu[im+1] - ctl->nu[id])) */
+  /* Check method... */
+  if(aero->nn[count]!=0 && aero->nn[count]!=1)
+    ERRMSG("Set particle concentration to 0 (closest wavenumber) or 1 (interpolation) for external database!");
+
+  /* Get database (each file is read only once)... */
+  for(i=0; i<ndb; i++)
+    if(strcmp(db[i].file, aero->filepath[count])==0)
+      d=&db[i];
+  if(d==NULL) {
+    if(ndb>=SCAMOD)
+      ERRMSG("Too many optical properties databases!");
+    d=&db[ndb++];
+    read_extdb(aero->filepath[count], d);
+  }
+
+  /* Loop over spectral points... */
+  for(id=0; id<ctl->nd; id++){
+
+    /* Find closest match in wavenumber */
+    if(aero->nn[count]==0 || d->n<2) {
+      im=(d->n<2 ? 0 : locate(d->nu, d->n, ctl->nu[id]));
+      if(d->n>=2 && fabs(d->nu[im] - ctl->nu[id]) > fabs(d->nu[im+1] - ctl->nu[id]))
 	im=im+1;
       
-      beta_ext[id] = n_ext[im];
-      beta_sca[id] = n_sca[im];
+      beta_ext[id] = d->beta_e[im];
+      beta_sca[id] = d->beta_s[im];
+      for (ia=0; ia<NTHETA; ++ia)
+      	phase[id][ia] = d->p[im*NTHETA+ia];
+    }
+
+    /* Interpolate linearly in wavenumber (constant outside of database) */
+    else {
+      im=locate(d->nu, d->n, ctl->nu[id]);
+      w=(ctl->nu[id]-d->nu[im])/(d->nu[im+1]-d->nu[im]);
+      w=GSL_MIN(GSL_MAX(w, 0), 1);
+      beta_ext[id] = (1-w)*d->beta_e[im] + w*d->beta_e[im+1];
+      beta_sca[id] = (1-w)*d->beta_s[im] + w*d->beta_s[im+1];
       for (ia=0; ia<NTHETA; ++ia)
-      	phase[id][ia] = n_phase[im][ia];
+      	phase[id][ia] = (1-w)*d->p[im*NTHETA+ia] + w*d->p[(im+1)*NTHETA+ia];
     }
   }
+}
+
+/*****************************************************************************/
 
-  /* Read optical properties and interpolate to wavenumber */
-  if(aero->nn[count]==1) {
-    ERRMSG("Implement me!");
+void read_extdb(const char *filename,
+		extdb_t *db) {
+  
+  FILE *in;
+  
+  char line[LEN], magic[4], *tok;
+  
+  int ia, n[2];
+  
+  /* Write info... */
+  printf("Read non-spherical optical properties: %s\n", filename);
+  
+  /* Open file... */
+  if(!(in=fopen(filename, "r")))
+    ERRMSG("Cannot open file!");
+  strcpy(db->file, filename);
+  
+  /* Read binary data... */
+  if(fread(magic, 1, 4, in)==4 && memcmp(magic, "JEXT", 4)==0) {
+    FREAD(n, int, 2, in);
+    if(n[0]!=1)
+      ERRMSG("Unknown version of binary data!");
+    FREAD(&db->n, int, 1, in);
+    FREAD(n, int, 1, in);
+    if(n[0]!=NTHETA)
+      ERRMSG("Number of scattering angles does not match!");
+    ALLOC(db->nu, double, db->n);
+    ALLOC(db->beta_e, double, db->n);
+    ALLOC(db->beta_s, double, db->n);
+    ALLOC(db->p, double, db->n*NTHETA);
+    FREAD(db->nu, double, db->n, in);
+    FREAD(db->beta_e, double, db->n, in);
+    FREAD(db->beta_s, double, db->n, in);
+    FREAD(db->p, double, db->n*NTHETA, in);
+  }
+  
+  /* Read ASCII data... */
+  else {
+    rewind(in);
+    ALLOC(db->nu, double, REFMAX);
+    ALLOC(db->beta_e, double, REFMAX);
+    ALLOC(db->beta_s, double, REFMAX);
+    ALLOC(db->p, double, REFMAX*NTHETA);
+    db->n=0;
+    while(fgets(line, LEN, in)) {
+      TOKD(line, tok, db->nu[db->n]);  
+      TOKD(NULL, tok, db->beta_e[db->n]);
+      TOKD(NULL, tok, db->beta_s[db->n]);
+      for(ia=0; ia<NTHETA; ia++)
+	TOKD(NULL, tok, db->p[db->n*NTHETA+ia]);
+      if((++db->n)>REFMAX)
+	ERRMSG("Too many data points!");
+    }
   }
+  
+  /* Close file... */
+  fclose(in);
+  
+  /* Check number of points... */
+  if(db->n<1)
+    ERRMSG("Could not read any data!");
 }
 
 /*****************************************************************************/
@@ -590,6 +1101,7 @@ void read_aero(const char *dirname,
   
   /* Init... */
   aero->nm=0;
+  aero->lin=0;
   
   /* Set filename... */
   if(dirname!=NULL)
@@ -608,14 +1120,14 @@ void read_aero(const char *dirname,
   while(fgets(line, LEN, in)) {
     
     /* Read data... */
-    TOK(line, tok, "%lg", aero->top_mod[aero->nm]);
-    TOK(NULL, tok, "%lg", aero->bottom_mod[aero->nm]);
-    TOK(NULL, tok, "%lg", aero->trans_mod[aero->nm]);
+    TOKD(line, tok, aero->top_mod[aero->nm]);
+    TOKD(NULL, tok, aero->bottom_mod[aero->nm]);
+    TOKD(NULL, tok, aero->trans_mod[aero->nm]);
     TOK(NULL, tok, "%s",  aero->type[aero->nm][0]);
     TOK(NULL, tok, "%s",  aero->filepath[aero->nm][0]); 
-    TOK(NULL, tok, "%lg", aero->nn[aero->nm]); 
-    TOK(NULL, tok, "%lg", aero->rr[aero->nm]);
-    TOK(NULL, tok, "%lg", aero->ss[aero->nm]);
+    TOKD(NULL, tok, aero->nn[aero->nm]); 
+    TOKD(NULL, tok, aero->rr[aero->nm]);
+    TOKD(NULL, tok, aero->ss[aero->nm]);
     
     /* Increment counter... */
     if((++aero->nm)>SCAMOD)
@@ -671,28 +1183,27 @@ void srcfunc_sca_1d(ctl_t *ctl,
 		    double *src_sca,
 		    int scattering) {
   
-  obs_t *obs2;
+  double alpha[NSCAALF], lat, lon, rad[NDMAX][NSCAALF], z;
   
-  double alpha[NTHETA], alpha2, dnorth[3], ek[3], lx[3], ly[3], lz[3], phi,
-    phase2, rad, sx[3], sy[3], sz[3], theta[NTHETA], theta2, w=0, wsum[NDMAX], xv[3];
+  /* Set incident zenith angles... */
+  srcfunc_sca_1d_ang(alpha);
   
-  int i, id, idp, idx, iphi, ir, itheta, nalpha=28, nphi=180, ntheta2=180;
+  /* Get incident radiation (from radiance field or pencil beams)... */
+  cart2geo(x, &z, &lon, &lat);
+  if(!srcfunc_sca_field(ctl, atm, aero, z, scattering, 0, rad))
+    srcfunc_sca_1d_inc(ctl, atm, aero, x, alpha, scattering, rad);
+  
+  /* Integrate... */
+  srcfunc_sca_1d_int(ctl, aero, x, dx, il, alpha, rad, src_sca);
+}
 
-  int n1=1, n2=2;
-  double midang=83, up=92, down=81, step=1+2;
+/*****************************************************************************/
+
+void srcfunc_sca_1d_ang(double *alpha) {
   
-  /* Allocate... */
-  ALLOC(obs2, obs_t, 1);
+  double midang=83, up=92, down=81, step=1+2;
   
-  /* Set scattering phase function angles... */
-  for(itheta=0; itheta<NTHETA; itheta++)
-    theta[itheta]=(double)itheta*M_PI/180.;
-  
-  /* Get local coordinate system... */
-  dnorth[0]=-x[0];
-  dnorth[1]=-x[1];
-  dnorth[2]=2*RE-x[2];
-  bascoord(x, dnorth, lx, ly, lz);
+  int ir, nalpha=NSCAALF, n1=1, n2=2;
   
   /* Set angles - tested version with nalpha=28 and Fibonacci Numbers */
   alpha[0] = 0;
@@ -712,41 +1223,87 @@ void srcfunc_sca_1d(ctl_t *ctl,
     } 
   }
   alpha[nalpha-1] = M_PI;
+}
+
+/*****************************************************************************/
 
+void srcfunc_sca_1d_inc(ctl_t *ctl,
+			atm_t *atm,
+			aero_t *aero,
+			double *x,
+			double *alpha,
+			int scattering,
+			double rad[NDMAX][NSCAALF]) {
+  
+  double *rad2, xv[3*NSCAALF];
+  
+  int id, ir;
+  
+  /* Allocate... */
+  ALLOC(rad2, double, NSCAALF*ctl->nd);
+  
+  /* Set view points... */
+  srcfunc_sca_1d_vp(x, alpha, xv);
+  
   /* Get incident radiation... */
-  /* nalpha=181; */
-  for(ir=0; ir<nalpha; ir++) {
-    
-    /* Set angle... */
-    /* traditional 0-180 deg in 1 deg steps with nalpha=181 */
-    /* alpha[ir] = ir*M_PI/180.; */
+  srcfunc_sca_beams(ctl, atm, aero, x, NSCAALF, xv, scattering, rad2);
+  
+  /* Copy radiance... */
+  for(ir=0; ir<NSCAALF; ir++)
+    for(id=0; id<ctl->nd; id++)
+      rad[id][ir]=rad2[ir*ctl->nd+id];
+  
+  /* Free... */
+  free(rad2);
+}
 
-    /* initial version with nalpha=21 */
-    /* alpha[ir]=acos(2*(double)ir/(nalpha-1.0)-1.0); */
+/*****************************************************************************/
+
+void srcfunc_sca_1d_int(ctl_t *ctl,
+			aero_t *aero,
+			double *x,
+			double *dx,
+			int il,
+			double *alpha,
+			double rad[NDMAX][NSCAALF],
+			double *src_sca) {
   
-    /* Set view point... */
-    for(i=0; i<3; i++)
-      /* xv[i]=x[i]+10.*cos(alpha[ir])*lz[i]+10.*sin(alpha[ir])*ly[i];  */
-      xv[i]=x[i]+10.*cos(alpha[ir])*(-1)*lz[i]+10.*sin(alpha[ir])*ly[i];
-    
-    /* Set observation geometry... */
-    obs2->nr=nalpha;
-    cart2geo(x, &obs2->obsz[ir], &obs2->obslon[ir], &obs2->obslat[ir]);
-    cart2geo(xv, &obs2->vpz[ir], &obs2->vplon[ir], &obs2->vplat[ir]);
-    
-    /* Get pencil beam radiance... */
-    formod_pencil(ctl, atm, obs2, aero, scattering-1, ir);
-  }
+  double alpha2, dnorth[3], ek[3], lx[3], ly[3], lz[3], phase2, phi, rad2,
+    sx[3], sy[3], sz[3], theta[NTHETA], theta2, w, wgt[NDMAX][NSCAALF],
+    wsum[NDMAX];
+  
+  int i, id, idp, idx, iphi, ir, itheta, nphi=180, ntheta2=180;
+  
+  /* Get local coordinate system... */
+  dnorth[0]=-x[0];
+  dnorth[1]=-x[1];
+  dnorth[2]=2*RE-x[2];
+  bascoord(x, dnorth, lx, ly, lz);
   
   /* Get orthonormal basis (with respect to LOS)... */
   bascoord(dx, x, sx, sy, sz);  
   
+  /* Integrate with tabulated weights (depend on LOS zenith angle only)... */
+  if(ctl->sca_wtab) {
+    srcfunc_sca_1d_wgt(ctl, aero, alpha, il, DOTP(lz, sz), 0, wgt);
+    for(id=0; id<ctl->nd; id++) {
+      src_sca[id]=0;
+      for(ir=0; ir<NSCAALF; ir++)
+	src_sca[id]+=wgt[id][ir]*rad[id][ir];
+    }
+    return;
+  }
+  
+  /* Set scattering phase function angles... */
+  for(itheta=0; itheta<NTHETA; itheta++)
+    theta[itheta]=(double)itheta*M_PI/180.;
+  
   /* Initialize... */
   for(id=0; id<ctl->nd; id++){
     src_sca[id]=0;
     wsum[id]=0;
   }
-    
+  
   /* Loop over phase function angles... */
   for(itheta=0; itheta<ntheta2; itheta++) {
     
@@ -765,32 +1322,31 @@ void srcfunc_sca_1d(ctl_t *ctl,
 	  =sin(theta2)*sin(phi)*sx[i]
 	  +sin(theta2)*cos(phi)*sy[i]
 	  +cos(theta2)*sz[i];
-
+      
       /* Get phase function index */
       idp=locate(theta, NTHETA, theta2);
-
+      
       /* Get zenith angle... */
       alpha2=ANGLE(-1.*lz, ek);
-
+      
       /* Get source ray angle index */
-      idx=locate(alpha, nalpha, alpha2);
-	
+      idx=locate(alpha, NSCAALF, alpha2);
+      
       /* Loop over channels... */
       for(id=0; id<ctl->nd; id++) {
 	
 	/* Interpolate phase function... */
 	phase2=LIN(theta[idp], aero->p[il][id][idp],
 		   theta[idp+1], aero->p[il][id][idp+1], theta2);
-
+	
 	/* Get weighting factor (area of surface element * phase function)... */
 	w=sin(theta2)*phase2;
 	
 	/* Interpolate radiance to particular angle... */
-	rad=LIN(alpha[idx], obs2->rad[id][idx],
-	 	alpha[idx+1], obs2->rad[id][idx+1], alpha2);
+	rad2=LIN(alpha[idx], rad[id][idx], alpha[idx+1], rad[id][idx+1], alpha2);
 	
 	/* Integrate... */
-	src_sca[id]+=w*rad;
+	src_sca[id]+=w*rad2;
 	wsum[id]+=w;
       }
     }
@@ -799,9 +1355,187 @@ void srcfunc_sca_1d(ctl_t *ctl,
   /* Normalize... */
   for(id=0; id<ctl->nd; id++)
     src_sca[id]/=wsum[id]; 
+}
+
+/*****************************************************************************/
+
+void srcfunc_sca_1d_vp(double *x,
+		       double *alpha,
+		       double *xv) {
   
-  /* Free... */
-  free(obs2);
+  double dnorth[3], lx[3], ly[3], lz[3];
+  
+  int i, ir, nalpha=NSCAALF;
+  
+  /* Get local coordinate system... */
+  dnorth[0]=-x[0];
+  dnorth[1]=-x[1];
+  dnorth[2]=2*RE-x[2];
+  bascoord(x, dnorth, lx, ly, lz);
+  
+  /* Set view points... */
+  /* nalpha=181; */
+  for(ir=0; ir<nalpha; ir++) {
+    
+    /* Set angle... */
+    /* traditional 0-180 deg in 1 deg steps with nalpha=181 */
+    /* alpha[ir] = ir*M_PI/180.; */
+
+    /* initial version with nalpha=21 */
+    /* alpha[ir]=acos(2*(double)ir/(nalpha-1.0)-1.0); */
+  
+    for(i=0; i<3; i++)
+      /* xv[i]=x[i]+10.*cos(alpha[ir])*lz[i]+10.*sin(alpha[ir])*ly[i];  */
+      xv[3*ir+i]=x[i]+10.*cos(alpha[ir])*(-1)*lz[i]+10.*sin(alpha[ir])*ly[i];
+  }
+}
+
+/*****************************************************************************/
+
+void srcfunc_sca_1d_wgt(ctl_t *ctl,
+			aero_t *aero,
+			double *alpha,
+			int il,
+			double cosz,
+			int init,
+			double wgt[NDMAX][NSCAALF]) {
+  
+  static double *geo[NSCAZEN], (*psnap)[NDMAX][NTHETA],
+    (*wtab[NLMAX][NSCAZEN])[NSCAALF];
+  
+  static int nd=-1;
+  
+  double alpha2, cphi[180], ek[3], f, phase2[NDMAX][180], phi,
+    sth[180], theta[NTHETA], theta2, u, (*w)[NSCAALF], (*w0)[NSCAALF],
+    (*w1)[NSCAALF], wsum[NDMAX];
+  
+  int i, id, idp, idx, iphi, ir, itheta, iz, jl, jz, nalpha=NSCAALF, nphi=180,
+    ntheta2=180;
+  
+  /* Check tables (called outside of parallel regions)... */
+  if(init) {
+    if(!ctl->sca_wtab || ctl->sca_n<=0)
+      return;
+    
+    /* Allocate... */
+    if(psnap==NULL)
+      ALLOC(psnap, double[NDMAX][NTHETA], NLMAX);
+    
+    /* Invalidate weights of layers with changed phase functions... */
+    for(jl=0; jl<aero->nl; jl++)
+      if(nd!=ctl->nd || memcmp(psnap[jl], aero->p[jl],
+			       (size_t)ctl->nd*NTHETA*sizeof(double))!=0) {
+	for(jz=0; jz<NSCAZEN; jz++)
+	  if(wtab[jl][jz]!=NULL) {
+	    free(wtab[jl][jz]);
+	    wtab[jl][jz]=NULL;
+	  }
+	memcpy(psnap[jl], aero->p[jl], (size_t)ctl->nd*NTHETA*sizeof(double));
+      }
+    for(jl=aero->nl; jl<NLMAX; jl++)
+      for(jz=0; jz<NSCAZEN; jz++)
+	if(wtab[jl][jz]!=NULL) {
+	  free(wtab[jl][jz]);
+	  wtab[jl][jz]=NULL;
+	}
+    nd=ctl->nd;
+    return;
+  }
+  
+  /* Check initialization... */
+  if(nd!=ctl->nd)
+    ERRMSG("Weights of scattering source not initialized!");
+  
+  /* Get LOS zenith angle bin... */
+  u=acos(GSL_MIN(GSL_MAX(cosz, -1), 1))/M_PI*(NSCAZEN-1);
+  iz=GSL_MIN_INT((int)u, NSCAZEN-2);
+  f=u-iz;
+  
+  /* Get weights for the two bracketing LOS zenith angles... */
+  for(jz=iz; jz<=iz+1; jz++) {
+    w=wtab[il][jz];
+#ifdef _OPENMP
+#pragma omp flush
+#endif
+    if(w!=NULL)
+      continue;
+    
+    /* Compute missing weights (one thread at a time)... */
+#ifdef _OPENMP
+#pragma omp critical(srcfunc_sca_1d_wgt)
+#endif
+    if(wtab[il][jz]==NULL) {
+      
+      /* Get area-weighted interpolation coefficients on the incident
+	 zenith angle grid for each scattering angle (geometry only)... */
+      if(geo[jz]==NULL) {
+	ALLOC(geo[jz], double, ntheta2*nalpha);
+	for(i=0; i<ntheta2*nalpha; i++)
+	  geo[jz][i]=0;
+	
+	/* LOS basis: local zenith is (0, sin(z), cos(z))... */
+	for(iphi=0; iphi<nphi; iphi++) {
+	  phi=2.*(0.5+iphi)*M_PI/180.;
+	  cphi[iphi]=cos(phi);
+	}
+	for(itheta=0; itheta<ntheta2; itheta++) {
+	  theta2=(0.5+itheta)*M_PI/180.;
+	  for(iphi=0; iphi<nphi; iphi++) {
+	    ek[1]=sin(theta2)*cphi[iphi];
+	    ek[2]=cos(theta2);
+	    alpha2=acos(GSL_MIN(GSL_MAX(-sin(jz*M_PI/(NSCAZEN-1))*ek[1]
+					 -cos(jz*M_PI/(NSCAZEN-1))*ek[2],
+					 -1), 1));
+	    idx=locate(alpha, nalpha, alpha2);
+	    u=(alpha2-alpha[idx])/(alpha[idx+1]-alpha[idx]);
+	    geo[jz][itheta*nalpha+idx]+=sin(theta2)*(1-u);
+	    geo[jz][itheta*nalpha+idx+1]+=sin(theta2)*u;
+	  }
+	}
+      }
+      
+      /* Interpolate phase function to scattering angles... */
+      for(itheta=0; itheta<NTHETA; itheta++)
+	theta[itheta]=(double)itheta*M_PI/180.;
+      for(itheta=0; itheta<ntheta2; itheta++) {
+	theta2=(0.5+itheta)*M_PI/180.;
+	sth[itheta]=sin(theta2);
+	idp=locate(theta, NTHETA, theta2);
+	for(id=0; id<nd; id++)
+	  phase2[id][itheta]=LIN(theta[idp], aero->p[il][id][idp],
+				 theta[idp+1], aero->p[il][id][idp+1],
+				 theta2);
+      }
+      
+      /* Sum up weights (area of surface element * phase function)... */
+      ALLOC(w, double[NSCAALF], nd);
+      for(id=0; id<nd; id++) {
+	wsum[id]=0;
+	for(ir=0; ir<nalpha; ir++)
+	  w[id][ir]=0;
+	for(itheta=0; itheta<ntheta2; itheta++) {
+	  wsum[id]+=nphi*sth[itheta]*phase2[id][itheta];
+	  for(ir=0; ir<nalpha; ir++)
+	    w[id][ir]+=phase2[id][itheta]*geo[jz][itheta*nalpha+ir];
+	}
+	for(ir=0; ir<nalpha; ir++)
+	  w[id][ir]/=wsum[id];
+      }
+      
+      /* Publish weights after they are complete... */
+#ifdef _OPENMP
+#pragma omp flush
+#endif
+      wtab[il][jz]=w;
+    }
+  }
+  
+  /* Interpolate weights to LOS zenith angle... */
+  w0=wtab[il][iz];
+  w1=wtab[il][iz+1];
+  for(id=0; id<nd; id++)
+    for(ir=0; ir<nalpha; ir++)
+      wgt[id][ir]=(1-f)*w0[id][ir]+f*w1[id][ir];
 }
 
 /*****************************************************************************/
@@ -815,80 +1549,526 @@ void srcfunc_sca_3d(ctl_t *ctl,
 		    double *src_sca,
 		    int scattering) {
   
-  obs_t *obs2;
-  
-  double phi, phase2, sx[3], sy[3], sz[3], theta[NTHETA], theta2,
-    w, wsum=0, xv[3];
+  double *domega, *phi, *rad, *theta2, *xv;
   
-  int i, id, idx, iphi, itheta, nphi=180, ntheta2=180;
+  int ndir;
   
   /* Allocate... */
-  ALLOC(obs2, obs_t, 1);
+  ALLOC(theta2, double, NSCADIR);
+  ALLOC(phi, double, NSCADIR);
+  ALLOC(domega, double, NSCADIR);
+  
+  /* Get directions of incident radiation... */
+  srcfunc_sca_3d_quad(ctl, aero, il, &ndir, theta2, phi, domega);
+  
+  /* Set view points... */
+  ALLOC(xv, double, 3*ndir);
+  srcfunc_sca_3d_vp(x, dx, ndir, theta2, phi, xv);
+  
+  /* Get incident radiation... */
+  ALLOC(rad, double, ndir*ctl->nd);
+  srcfunc_sca_beams(ctl, atm, aero, x, ndir, xv, scattering, rad);
+  
+  /* Integrate... */
+  srcfunc_sca_3d_int(ctl, aero, il, ndir, theta2, domega, rad, src_sca);
+  
+  /* Free... */
+  free(theta2);
+  free(phi);
+  free(domega);
+  free(xv);
+  free(rad);
+}
+
+/*****************************************************************************/
+
+void srcfunc_sca_3d_int(ctl_t *ctl,
+			aero_t *aero,
+			int il,
+			int ndir,
+			double *theta2,
+			double *domega,
+			double *rad,
+			double *src_sca) {
+  
+  double phase2, theta[NTHETA], w, wsum[NDMAX];
+  
+  int id, idir, idx, itheta;
   
   /* Set scattering phase function angles... */
   for(itheta=0; itheta<NTHETA; itheta++)
     theta[itheta]=M_PI*(double)itheta/(NTHETA-1);
   
+  /* Initialize... */
+  for(id=0; id<ctl->nd; id++) {
+    src_sca[id]=0;
+    wsum[id]=0;
+  }
+  
+  /* Loop over directions... */
+  for(idir=0; idir<ndir; idir++) {
+    
+    /* Get phase function index */
+    idx=locate(theta, NTHETA, theta2[idir]);
+    
+    /* Loop over channels... */
+    for(id=0; id<ctl->nd; id++) {
+      
+      /* Interpolate phase function... */
+      phase2=LIN(theta[idx], aero->p[il][id][idx],
+		 theta[idx+1], aero->p[il][id][idx+1], theta2[idir]);
+      
+      /* Get weighting factor (solid angle * phase function)... */
+      w=domega[idir]*phase2;
+      
+      /* Integrate... */
+      src_sca[id]+=w*rad[idir*ctl->nd+id];
+      wsum[id]+=w;
+    }
+  }
+  
+  /* Normalize... */
+  for(id=0; id<ctl->nd; id++)
+    src_sca[id]/=wsum[id];
+}
+
+/*****************************************************************************/
+
+void srcfunc_sca_3d_quad(ctl_t *ctl,
+			 aero_t *aero,
+			 int il,
+			 int *ndir,
+			 double *theta2,
+			 double *phi,
+			 double *domega) {
+  
+  double cdf[NTHETA], dens[NTHETA], pmean=0, theta[NTHETA], u0, u1;
+  
+  int id, idir, idx, iphi, itheta, nphi=180, ntheta2=180;
+  
+  /* Regular grid in scattering and azimuth angle... */
+  if(ctl->sca_ndir<=0) {
+    *ndir=0;
+    for(itheta=0; itheta<ntheta2; itheta++)
+      for(iphi=0; iphi<nphi; iphi++) {
+	theta2[*ndir]=(0.5+itheta)/ntheta2*M_PI;
+	phi[*ndir]=(0.5+iphi)/nphi*2*M_PI;
+	domega[*ndir]=M_PI/ntheta2*2*M_PI*sin(theta2[*ndir])/nphi;
+	(*ndir)++;
+      }
+    return;
+  }
+  
+  /* Get mean phase function of layer... */
+  for(itheta=0; itheta<NTHETA; itheta++) {
+    theta[itheta]=M_PI*(double)itheta/(NTHETA-1);
+    dens[itheta]=0;
+    for(id=0; id<ctl->nd; id++)
+      dens[itheta]+=aero->p[il][id][itheta]/ctl->nd;
+    if(itheta>0)
+      pmean+=0.25*(dens[itheta-1]*sin(theta[itheta-1])
+		   +dens[itheta]*sin(theta[itheta]))
+	*(theta[itheta]-theta[itheta-1]);
+  }
+  
+  /* Set density of directions (uniform plus phase function weighted)... */
+  for(itheta=0; itheta<NTHETA; itheta++)
+    dens[itheta]=(pmean>0 ? (1-ctl->sca_fwd)+ctl->sca_fwd*dens[itheta]/pmean
+		  : 1);
+  
+  /* Get cumulative distribution in scattering angle... */
+  cdf[0]=0;
+  for(itheta=1; itheta<NTHETA; itheta++)
+    cdf[itheta]=cdf[itheta-1]
+      +0.5*(dens[itheta-1]*sin(theta[itheta-1])
+	    +dens[itheta]*sin(theta[itheta]))
+      *(theta[itheta]-theta[itheta-1]);
+  
+  /* Spherical Fibonacci lattice with equal probability bands... */
+  *ndir=ctl->sca_ndir;
+  for(idir=0; idir<*ndir; idir++) {
+    
+    /* Get scattering angle (center of band)... */
+    u0=(0.5+idir)/(*ndir)*cdf[NTHETA-1];
+    idx=locate(cdf, NTHETA, u0);
+    theta2[idir]=LIN(cdf[idx], theta[idx], cdf[idx+1], theta[idx+1], u0);
+    
+    /* Get solid angle of band... */
+    u0=(double)idir/(*ndir)*cdf[NTHETA-1];
+    idx=locate(cdf, NTHETA, u0);
+    u0=LIN(cdf[idx], theta[idx], cdf[idx+1], theta[idx+1], u0);
+    u1=(idir+1.)/(*ndir)*cdf[NTHETA-1];
+    idx=locate(cdf, NTHETA, u1);
+    u1=LIN(cdf[idx], theta[idx], cdf[idx+1], theta[idx+1], u1);
+    domega[idir]=2*M_PI*(cos(u0)-cos(u1));
+    
+    /* Set azimuth angle (golden angle increments)... */
+    phi[idir]=fmod(idir*M_PI*(3-sqrt(5.)), 2*M_PI);
+  }
+}
+
+/*****************************************************************************/
+
+void srcfunc_sca_3d_vp(double *x,
+		       double *dx,
+		       int ndir,
+		       double *theta2,
+		       double *phi,
+		       double *xv) {
+  
+  double sx[3], sy[3], sz[3];
+  
+  int i, idir;
+  
   /* Get orthonormal basis (with respect to LOS)... */
   bascoord(dx, x, sx, sy, sz);  
   
-  /* Initialize... */
-  for(id=0; id<ctl->nd; id++)
-    src_sca[id]=0;
+  /* Set view points... */
+  for(idir=0; idir<ndir; idir++)
+    for(i=0; i<3; i++)
+      xv[3*idir+i]=x[i]
+	+10*sin(theta2[idir])*sin(phi[idir])*sx[i]
+	+10*sin(theta2[idir])*cos(phi[idir])*sy[i]
+	+10*cos(theta2[idir])*sz[i];
+}
+
+/*****************************************************************************/
+
+void srcfunc_sca_beams(ctl_t *ctl,
+		       atm_t *atm,
+		       aero_t *aero,
+		       double *x,
+		       int nbeam,
+		       double *xv,
+		       int scattering,
+		       double *rad) {
   
-  /* Loop over phase function angles... */
-  for(itheta=0; itheta<ntheta2; itheta++) {
+  obs_t *obs2;
+  
+  int ib, id;
+  
+  /* Trace pencil beams as tasks (idle threads of the ray loop in formod
+     pick them up; each beam has its own scratch buffer and output
+     slot, so the results do not depend on the number of threads)... */
+#ifdef _OPENMP
+#pragma omp taskloop default(shared) private(ib,id,obs2) grainsize(1)
+#endif
+  for(ib=0; ib<nbeam; ib++) {
     
-    /* Set phase function angle... */
-    theta2=(0.5+itheta)/ntheta2*M_PI;
+    /* Allocate... */
+    ALLOC(obs2, obs_t, 1);
     
-    /* Loop over azimuth angles... */
-    for(iphi=0; iphi<nphi; iphi++) {
+    /* Set observation geometry... */
+    obs2->nr=1;
+    cart2geo(x, &obs2->obsz[0], &obs2->obslon[0], &obs2->obslat[0]);
+    cart2geo(&xv[3*ib], &obs2->vpz[0], &obs2->vplon[0], &obs2->vplat[0]);
+    
+    /* Get pencil beam radiance... */
+    formod_pencil(ctl, atm, obs2, aero, scattering-1, 0, NULL);
+    
+    /* Copy radiance... */
+    for(id=0; id<ctl->nd; id++)
+      rad[ib*ctl->nd+id]=obs2->rad[id][0];
+    
+    /* Free... */
+    free(obs2);
+  }
+}
+
+/*****************************************************************************/
+
+void srcfunc_sca_collect(ctl_t *ctl,
+			 atm_t *atm,
+			 aero_t *aero,
+			 obs_t *obs,
+			 scaq_t *q) {
+  
+  double alpha[NSCAALF], *dx, lat, lon, rad[NDMAX][NSCAALF], src_sca[NDMAX],
+    *x, z;
+  
+  int ia, ib, id, il, ir, isp;
+  
+  /* Set incident zenith angles... */
+  srcfunc_sca_1d_ang(alpha);
+  
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)			\
+  private(ia,ib,id,il,isp,dx,lat,lon,rad,src_sca,x,z)
+#endif
+  
+  /* Loop over primary rays... */
+  for(ir=0; ir<obs->nr; ir++)
+    for(isp=0; isp<q->np[ir]; isp++) {
       
-      /* Set azimuth angle... */
-      phi=(0.5+iphi)/nphi*2*M_PI;
+      /* Get scattering point... */
+      x=&q->x[ir][3*isp];
+      dx=&q->dx[ir][3*isp];
+      il=q->il[ir][isp];
+      ib=q->ib[ir][isp];
       
-      /* Set view point... */
-      for(i=0; i<3; i++)
-	xv[i]=x[i]
-	  +10*sin(theta2)*sin(phi)*sx[i]
-	  +10*sin(theta2)*cos(phi)*sy[i]
-	  +10*cos(theta2)*sz[i];
+      /* Scattering of thermal radiation (1D)... */
+      if(ctl->ip==1) {
+	cart2geo(x, &z, &lon, &lat);
+	if(ib<0)
+	  srcfunc_sca_field(ctl, atm, aero, z, ctl->sca_mult, 0, rad);
+	else
+	  for(ia=0; ia<NSCAALF; ia++)
+	    for(id=0; id<ctl->nd; id++)
+	      rad[id][ia]=q->rad[(ib+ia)*ctl->nd+id];
+	srcfunc_sca_1d_int(ctl, aero, x, dx, il, alpha, rad, src_sca);
+      }
       
-      /* Set observation geometry... */
-      obs2->nr=1;
-      cart2geo(x, &obs2->obsz[0], &obs2->obslon[0], &obs2->obslat[0]);
-      cart2geo(xv, &obs2->vpz[0], &obs2->vplon[0], &obs2->vplat[0]);
+      /* Scattering of thermal radiation (3D)... */
+      else
+	srcfunc_sca_3d_int(ctl, aero, il, q->ndir[il], q->theta2[il],
+			   q->domega[il], &q->rad[ib*ctl->nd], src_sca);
       
-      /* Get incident radiation... */
-      formod_pencil(ctl, atm, obs2, aero, scattering-1, 0);
+      /* Compute scattering of solar radiation... */
+      if(TSUN>0)
+	srcfunc_sca_sun(ctl, atm, aero, obs->time[ir], x, dx, il, src_sca);
       
-      /* Get phase function index */
-      idx=locate(theta, NTHETA, theta2);
+      /* Add scattering source to radiance of primary ray... */
+      for(id=0; id<ctl->nd; id++)
+	obs->rad[id][ir]+=q->w[ir][isp*ctl->nd+id]*src_sca[id];
+    }
+}
 
-      /* Loop over channels... */
-      for(id=0; id<ctl->nd; id++) {
-	
-	/* Interpolate phase function... */
-	phase2=LIN(theta[idx], aero->p[il][id][idx],
-		   theta[idx+1], aero->p[il][id][idx+1], theta2);
-	
-	/* Get weighting factor (surface element area * phase function)... */
-	w=M_PI/ntheta2*2*M_PI*sin(theta2)/nphi*phase2;
-	
-	/* Integrate... */
-	src_sca[id]+=w*obs2->rad[id][0];
-	wsum+=w;
+/*****************************************************************************/
+
+int srcfunc_sca_field(ctl_t *ctl,
+		      atm_t *atm,
+		      aero_t *aero,
+		      double z,
+		      int scattering,
+		      int init,
+		      double rad[NDMAX][NSCAALF]) {
+  
+  static double dz, *field, z0;
+  
+  static int nord=0, nz=0;
+  
+  double alpha[NSCAALF], w, x[3], zmax;
+  
+  int id, il, iord, ir, iz;
+  
+  /* Set up radiance field... */
+  if(init) {
+    
+    /* Free old field... */
+    if(nord>0) {
+      free(field);
+      nord=0;
+    }
+    
+    /* Check if field is needed... */
+    if(ctl->ip!=1 || ctl->sca_dz<=0 || ctl->sca_n<=0 || ctl->sca_mult<=0
+       || aero->nl<=0)
+      return 0;
+    
+    /* Get altitude range of aerosol/cloud layers... */
+    z0=aero->bottom[0]-aero->trans[0];
+    zmax=aero->top[0]+aero->trans[0];
+    for(il=1; il<aero->nl; il++) {
+      z0=GSL_MIN(z0, aero->bottom[il]-aero->trans[il]);
+      zmax=GSL_MAX(zmax, aero->top[il]+aero->trans[il]);
+    }
+    
+    /* Allocate... */
+    dz=ctl->sca_dz;
+    nz=GSL_MAX_INT((int)ceil((zmax-z0)/dz)+1, 2);
+    ALLOC(field, double, ctl->sca_mult*nz*ctl->nd*NSCAALF);
+    
+    /* Set incident zenith angles... */
+    srcfunc_sca_1d_ang(alpha);
+    
+    /* Loop over scattering orders (solar scattering of secondary beams
+       depends on location, so only first order is horizontally
+       homogeneous)... */
+    for(iord=1; iord<=(TSUN>0 ? 1 : ctl->sca_mult); iord++) {
+      
+      /* Do first altitude sequential (to initialize model)... */
+      geo2cart(z0, 0, 0, x);
+      srcfunc_sca_1d_inc(ctl, atm, aero, x, alpha, iord,
+			 (double(*)[NSCAALF])
+			 &field[((iord-1)*nz)*ctl->nd*NSCAALF]);
+      
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) private(iz,x)
+#endif
+      
+      /* Do remaining altitudes in parallel... */
+      for(iz=1; iz<nz; iz++) {
+	geo2cart(z0+iz*dz, 0, 0, x);
+	srcfunc_sca_1d_inc(ctl, atm, aero, x, alpha, iord,
+			   (double(*)[NSCAALF])
+			   &field[((iord-1)*nz+iz)*ctl->nd*NSCAALF]);
       }
+      
+      /* Make field of this order available for next order... */
+      nord=iord;
     }
+    
+    return 1;
   }
   
-  /* Normalize... */
+  /* Check if field is available... */
+  if(scattering<1 || scattering>nord || z<z0 || z>z0+(nz-1)*dz)
+    return 0;
+  
+  /* Interpolate... */
+  iz=GSL_MIN_INT((int)((z-z0)/dz), nz-2);
+  w=(z-z0)/dz-iz;
+  for(id=0; id<ctl->nd; id++)
+    for(ir=0; ir<NSCAALF; ir++)
+      rad[id][ir]
+	=(1-w)*field[(((scattering-1)*nz+iz)*ctl->nd+id)*NSCAALF+ir]
+	+w*field[(((scattering-1)*nz+iz+1)*ctl->nd+id)*NSCAALF+ir];
+  return 1;
+}
+
+/*****************************************************************************/
+
+int srcfunc_sca_plan(ctl_t *ctl,
+		     scaq_t *q,
+		     double *x,
+		     double *dx,
+		     int il,
+		     int ir) {
+  
+  int i, id;
+  
+  /* Grow arrays of primary ray... */
+  if(q->np[ir]>=q->npmax[ir]) {
+    q->npmax[ir]=GSL_MAX_INT(2*q->npmax[ir], 64);
+    if((q->x[ir]=realloc(q->x[ir], (size_t)(3*q->npmax[ir])*sizeof(double)))
+       ==NULL
+       || (q->dx[ir]=realloc(q->dx[ir],
+			     (size_t)(3*q->npmax[ir])*sizeof(double)))==NULL
+       || (q->il[ir]=realloc(q->il[ir],
+			     (size_t)q->npmax[ir]*sizeof(int)))==NULL
+       || (q->ib[ir]=realloc(q->ib[ir],
+			     (size_t)q->npmax[ir]*sizeof(int)))==NULL
+       || (q->w[ir]=realloc(q->w[ir], (size_t)(q->npmax[ir]*ctl->nd)
+			    *sizeof(double)))==NULL)
+      ERRMSG("Out of memory!");
+  }
+  
+  /* Save scattering point... */
+  for(i=0; i<3; i++) {
+    q->x[ir][3*q->np[ir]+i]=x[i];
+    q->dx[ir][3*q->np[ir]+i]=dx[i];
+  }
+  q->il[ir][q->np[ir]]=il;
   for(id=0; id<ctl->nd; id++)
-    src_sca[id]/=wsum;
+    q->w[ir][q->np[ir]*ctl->nd+id]=0;
   
-  /* Free... */
-  free(obs2);
+  return q->np[ir]++;
+}
+
+/*****************************************************************************/
+
+void srcfunc_sca_queue(ctl_t *ctl,
+		       atm_t *atm,
+		       aero_t *aero,
+		       obs_t *obs,
+		       scaq_t *q) {
+  
+  obs_t *obs2;
+  
+  double alpha[NSCAALF], lat, lon, rad[NDMAX][NSCAALF], z;
+  
+  int i, ib, ib0, ibat, id, il, ir, isp, nbat=32, ndir;
+  
+  /* Get directions of incident radiation for each layer (3D)... */
+  if(ctl->ip!=1)
+    for(il=0; il<aero->nl; il++) {
+      ALLOC(q->theta2[il], double, NSCADIR);
+      ALLOC(q->phi[il], double, NSCADIR);
+      ALLOC(q->domega[il], double, NSCADIR);
+      srcfunc_sca_3d_quad(ctl, aero, il, &q->ndir[il], q->theta2[il],
+			  q->phi[il], q->domega[il]);
+    }
+  
+  /* Assign secondary rays to scattering points (in order of primary
+     rays, so that the queue does not depend on the number of threads)... */
+  q->nb=0;
+  for(ir=0; ir<obs->nr; ir++)
+    for(isp=0; isp<q->np[ir]; isp++) {
+      cart2geo(&q->x[ir][3*isp], &z, &lon, &lat);
+      if(ctl->ip==1
+	 && srcfunc_sca_field(ctl, atm, aero, z, ctl->sca_mult, 0, rad))
+	q->ib[ir][isp]=-1;
+      else {
+	ndir=(ctl->ip==1 ? NSCAALF : q->ndir[q->il[ir][isp]]);
+	if(q->nb+ndir>NSCAQ)
+	  ERRMSG("Too many secondary rays, check NSCAQ and SCA_NDIR!");
+	q->ib[ir][isp]=q->nb;
+	q->nb+=ndir;
+      }
+    }
+  
+  /* Set up secondary rays... */
+  if(q->nb>0) {
+    ALLOC(q->xo, double, 3*q->nb);
+    ALLOC(q->xv, double, 3*q->nb);
+    ALLOC(q->ir, int, q->nb);
+    ALLOC(q->ip, int, q->nb);
+    ALLOC(q->ord, int, q->nb);
+    ALLOC(q->rad, double, q->nb*ctl->nd);
+    srcfunc_sca_1d_ang(alpha);
+    for(ir=0; ir<obs->nr; ir++)
+      for(isp=0; isp<q->np[ir]; isp++)
+	if((ib0=q->ib[ir][isp])>=0) {
+	  il=q->il[ir][isp];
+	  if(ctl->ip==1) {
+	    ndir=NSCAALF;
+	    srcfunc_sca_1d_vp(&q->x[ir][3*isp], alpha, &q->xv[3*ib0]);
+	  } else {
+	    ndir=q->ndir[il];
+	    srcfunc_sca_3d_vp(&q->x[ir][3*isp], &q->dx[ir][3*isp], ndir,
+			      q->theta2[il], q->phi[il], &q->xv[3*ib0]);
+	  }
+	  for(ib=ib0; ib<ib0+ndir; ib++) {
+	    for(i=0; i<3; i++)
+	      q->xo[3*ib+i]=q->x[ir][3*isp+i];
+	    q->ir[ib]=ir;
+	    q->ip[ib]=isp;
+	    q->ord[ib]=ctl->sca_mult-1;
+	  }
+	}
+  }
+  
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) private(ib,ib0,ibat,id,obs2)
+#endif
+  
+  /* Trace secondary rays in batches of neighboring rays... */
+  for(ibat=0; ibat<(q->nb+nbat-1)/nbat; ibat++) {
+    
+    /* Allocate... */
+    ALLOC(obs2, obs_t, 1);
+    
+    /* Set observation geometry... */
+    ib0=ibat*nbat;
+    obs2->nr=GSL_MIN_INT(nbat, q->nb-ib0);
+    for(ib=0; ib<obs2->nr; ib++) {
+      obs2->time[ib]=obs->time[q->ir[ib0+ib]];
+      cart2geo(&q->xo[3*(ib0+ib)], &obs2->obsz[ib], &obs2->obslon[ib],
+	       &obs2->obslat[ib]);
+      cart2geo(&q->xv[3*(ib0+ib)], &obs2->vpz[ib], &obs2->vplon[ib],
+	       &obs2->vplat[ib]);
+    }
+    
+    /* Get pencil beam radiances... */
+    for(ib=0; ib<obs2->nr; ib++) {
+      formod_pencil(ctl, atm, obs2, aero, q->ord[ib0+ib], ib, NULL);
+      for(id=0; id<ctl->nd; id++)
+	q->rad[(ib0+ib)*ctl->nd+id]=obs2->rad[id][ib];
+    }
+    
+    /* Free... */
+    free(obs2);
+  }
 }
 
 /*****************************************************************************/
@@ -967,7 +2147,7 @@ void srcfunc_sca_sun(ctl_t *ctl,
   if(los->tsurf<0) {
     
     /* Compute path transmittance... */
-    formod_pencil(ctl, atm, obs, aero, 0, 0);
+    formod_pencil(ctl, atm, obs, aero, 0, 0, NULL);
     
     /* Get phase function position... */
     theta2=ANGLE(ek, dx);
@@ -1039,6 +2219,38 @@ void suncoord(double sec,
 
 /*****************************************************************************/
 
+void write_extdb(const char *filename,
+		 extdb_t *db) {
+  
+  FILE *out;
+  
+  int n[2]={1, 0}, nt=NTHETA;
+  
+  /* Write info... */
+  printf("Write non-spherical optical properties: %s\n", filename);
+  
+  /* Create file... */
+  if(!(out=fopen(filename, "w")))
+    ERRMSG("Cannot create file!");
+  
+  /* Write header (magic, version, padding, size)... */
+  FWRITE("JEXT", char, 4, out);
+  FWRITE(n, int, 2, out);
+  FWRITE(&db->n, int, 1, out);
+  FWRITE(&nt, int, 1, out);
+  
+  /* Write data... */
+  FWRITE(db->nu, double, db->n, out);
+  FWRITE(db->beta_e, double, db->n, out);
+  FWRITE(db->beta_s, double, db->n, out);
+  FWRITE(db->p, double, db->n*NTHETA, out);
+  
+  /* Close file... */
+  fclose(out);
+}
+
+/*****************************************************************************/
+
 void write_aero(const char *dirname,
 		const char *filename,
 		aero_t *aero) {
@@ -26,6 +26,29 @@ void bhmie(double x,
 	   double *qext,
 	   double *qsca);
 
+/* Compute Mie parameters for a batch of size parameters. */
+void bhmie_batch(int nx,
+		 double *x,
+		 double n_real,
+		 double n_imag,
+		 double *phase,
+		 double *qext,
+		 double *qsca);
+
+/* Interpolate Mie parameters from lookup table. */
+void bhmie_tab(ctl_t *ctl,
+	       const char *refrac,
+	       double nu,
+	       double n_real,
+	       double n_imag,
+	       double xmin,
+	       double xmax,
+	       int nx,
+	       double *x,
+	       double *phase,
+	       double *qext,
+	       double *qsca);
+
 /* Gauss Hermite abcissas and weights. */
 void gauher(double *x,
 	    double *w);
@@ -36,17 +59,52 @@ void copy_aero(ctl_t *ctl,
 	       aero_t *aero_src,
 	       int init);
 
+/* Free queue of secondary rays. */
+void free_sca_queue(scaq_t *q);
+
+/* Get Mie lookup table (read from file or compute). */
+mietab_t *get_mie_tab(ctl_t *ctl,
+		      const char *refrac,
+		      double nu,
+		      double n_real,
+		      double n_imag,
+		      double xmin,
+		      double xmax);
+
 /* Get aerosol/cloud optical properties (1D). */
 void get_opt_prop(ctl_t *ctl,
 		  aero_t *aero);
 
-/* Calculate optical properties with Mie theory for a log-normal mode. */
+/* Calculate optical properties with Mie theory for a log-normal mode
+   (and optionally their derivatives with respect to nn, rr, and ss). */
 void opt_prop_mie_log(ctl_t *ctl,
 		    aero_t *aero,
 		    int count,
 		    double *beta_ext,
 		    double *beta_sca,
-		    double phase[NDMAX][NTHETA]);
+		    double phase[NDMAX][NTHETA],
+		    double dbeta_ext[3][NDMAX],
+		    double dbeta_sca[3][NDMAX],
+		    double dphase[3][NDMAX][NTHETA]);
+
+/* Sum up Mie parameters over nodes of a log-normal mode. */
+void opt_prop_mie_sum(ctl_t *ctl,
+		      const char *refrac,
+		      double *n_real,
+		      double *n_imag,
+		      double rad_min,
+		      double rad_max,
+		      double K1,
+		      int nrad,
+		      double *rads,
+		      double *w,
+		      double *dw,
+		      double *beta_ext,
+		      double *beta_sca,
+		      double phase[NDMAX][NTHETA],
+		      double dbeta_ext[3][NDMAX],
+		      double dbeta_sca[3][NDMAX],
+		      double dphase[3][NDMAX][NTHETA]);
 
 /* Get optical properties from external database. - New */
 void opt_prop_external(ctl_t *ctl,
@@ -56,6 +114,10 @@ void opt_prop_external(ctl_t *ctl,
 		      double *beta_sca,
 		      double phase[NDMAX][NTHETA]);
 
+/* Read optical properties database (ASCII or binary). */
+void read_extdb(const char *filename,
+		extdb_t *db);
+
 /* Read aerosol/cloud data. */
 void read_aero(const char *dirname,
 	       const char *filename,
@@ -83,6 +145,42 @@ void srcfunc_sca_1d(ctl_t *ctl,
 		    double *src_sca,
 		    int scattering);
 
+/* Set incident zenith angles for scattering source (1D). */
+void srcfunc_sca_1d_ang(double *alpha);
+
+/* Get incident radiances for scattering source from pencil beams (1D). */
+void srcfunc_sca_1d_inc(ctl_t *ctl,
+			atm_t *atm,
+			aero_t *aero,
+			double *x,
+			double *alpha,
+			int scattering,
+			double rad[NDMAX][NSCAALF]);
+
+/* Integrate scattering source over incident radiances (1D). */
+void srcfunc_sca_1d_int(ctl_t *ctl,
+			aero_t *aero,
+			double *x,
+			double *dx,
+			int il,
+			double *alpha,
+			double rad[NDMAX][NSCAALF],
+			double *src_sca);
+
+/* Set view points of pencil beams for scattering source (1D). */
+void srcfunc_sca_1d_vp(double *x,
+		       double *alpha,
+		       double *xv);
+
+/* Get weights of incident radiances for scattering source (1D). */
+void srcfunc_sca_1d_wgt(ctl_t *ctl,
+			aero_t *aero,
+			double *alpha,
+			int il,
+			double cosz,
+			int init,
+			double wgt[NDMAX][NSCAALF]);
+
 /* Compute scattering source (thermal emissions). */
 void srcfunc_sca_3d(ctl_t *ctl,
 		    atm_t *atm,
@@ -93,6 +191,74 @@ void srcfunc_sca_3d(ctl_t *ctl,
 		    double *src_sca,
 		    int scattering);
 
+/* Integrate scattering source over incident radiances (3D). */
+void srcfunc_sca_3d_int(ctl_t *ctl,
+			aero_t *aero,
+			int il,
+			int ndir,
+			double *theta2,
+			double *domega,
+			double *rad,
+			double *src_sca);
+
+/* Get quadrature directions for scattering source (3D). */
+void srcfunc_sca_3d_quad(ctl_t *ctl,
+			 aero_t *aero,
+			 int il,
+			 int *ndir,
+			 double *theta2,
+			 double *phi,
+			 double *domega);
+
+/* Set view points of pencil beams for scattering source (3D). */
+void srcfunc_sca_3d_vp(double *x,
+		       double *dx,
+		       int ndir,
+		       double *theta2,
+		       double *phi,
+		       double *xv);
+
+/* Trace pencil beams of incident radiation for scattering source. */
+void srcfunc_sca_beams(ctl_t *ctl,
+		       atm_t *atm,
+		       aero_t *aero,
+		       double *x,
+		       int nbeam,
+		       double *xv,
+		       int scattering,
+		       double *rad);
+
+/* Add scattering source from traced queue to radiances of primary rays. */
+void srcfunc_sca_collect(ctl_t *ctl,
+			 atm_t *atm,
+			 aero_t *aero,
+			 obs_t *obs,
+			 scaq_t *q);
+
+/* Get incident radiances from precomputed radiance field (1D). */
+int srcfunc_sca_field(ctl_t *ctl,
+		      atm_t *atm,
+		      aero_t *aero,
+		      double z,
+		      int scattering,
+		      int init,
+		      double rad[NDMAX][NSCAALF]);
+
+/* Save scattering point of primary ray for plan/execute mode. */
+int srcfunc_sca_plan(ctl_t *ctl,
+		     scaq_t *q,
+		     double *x,
+		     double *dx,
+		     int il,
+		     int ir);
+
+/* Set up and trace queue of secondary rays. */
+void srcfunc_sca_queue(ctl_t *ctl,
+		       atm_t *atm,
+		       aero_t *aero,
+		       obs_t *obs,
+		       scaq_t *q);
+
 /* Add solar radiation to scattering source. */
 void srcfunc_sca_sun(ctl_t *ctl,
 		     atm_t *atm,
@@ -110,6 +276,10 @@ void suncoord(double sec,
 	      double *azi,
 	      double *sza);
 
+/* Write optical properties database (binary). */
+void write_extdb(const char *filename,
+		 extdb_t *db);
+
 /* Write particle data. */
 void write_aero(const char *dirname,
 		const char *filename,